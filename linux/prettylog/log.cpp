@@ -3,16 +3,19 @@
 #include <optional>
 #include <fmt/ostream.h>
 #include <fmt/format.h>
+#include <ostream>
+#include <string_view>
 using namespace std::string_literals;
 using namespace fmt::literals;
 
-std::string logger::format_message(const logger_message_style &style, const std::string &message, bool is_term)
+static std::string format_line(const logger_config &cfg, const logger_message_style &style,
+	std::chrono::steady_clock::time_point time, std::string_view message, bool is_term)
 {
 	auto ansi_code = [is_term](int n){return is_term ? fmt::format("\x1b[{}m", n) : ""s;};
 	auto fg_color = [ansi_code](int n){return ansi_code((n > 7 ? 90 : 30) + n % 8);};
 	auto term_reset = ansi_code(0);
 
-	auto dt = std::chrono::steady_clock::now() - m_config.ref_time;
+	auto dt = time - cfg.ref_time;
 	auto dt_seconds = std::chrono::duration_cast<std::chrono::milliseconds>(dt);
 	return fmt::format("[{}{:0.3f}{}] {}{}:{} {}{}{}",
 		fg_color(2), dt_seconds.count() / 1000.0, term_reset,
@@ -21,6 +24,11 @@ std::string logger::format_message(const logger_message_style &style, const std:
 		);
 }
 
+std::string logger::format_message(const logger_message_style &style, const std::string &message, bool is_term)
+{
+	return format_line(m_config, style, std::chrono::steady_clock::now(), message, is_term);
+}
+
 void logger::file_dispatch(const logger_message_style &style, const std::string &s)
 {
 	std::optional<std::scoped_lock<std::mutex>> lock;
@@ -39,6 +47,138 @@ void logger::term_dispatch(const logger_message_style &style, const std::string
 	*m_config.term_stream << format_message(style, s, true) << std::endl;
 }
 
+log_ring_buffer::log_ring_buffer(std::size_t size)
+{
+	std::size_t n = 2;
+	while (n < size)
+		n *= 2;
+
+	m_slots = std::vector<slot>(n);
+	m_mask = n - 1;
+	for (std::size_t i = 0; i < n; i++)
+		m_slots[i].seq.store(i, std::memory_order_relaxed);
+}
+
+void log_ring_buffer::wait(const std::atomic<bool> &stop)
+{
+	// Anything published after the fence sees the consumer sleeping, and wakes it
+	auto signal = m_signal.load(std::memory_order_acquire);
+	m_sleeping.store(true, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (!front() && !stop.load())
+		m_signal.wait(signal, std::memory_order_acquire);
+	m_sleeping.store(false, std::memory_order_relaxed);
+}
+
+void log_ring_buffer::wake()
+{
+	m_signal.fetch_add(1, std::memory_order_release);
+	m_signal.notify_one();
+}
+
+logger::logger(logger_config cfg) :
+	m_config(std::move(cfg))
+{
+	if (m_config.async)
+	{
+		m_async = std::make_shared<async_state>(m_config);
+		m_async->thread = std::thread(&async_state::run, m_async.get());
+	}
+}
+
+log_ring_buffer::record *logger::claim_slow(std::size_t &pos)
+{
+	if (m_config.overflow != logger_overflow::block)
+	{
+		m_async->dropped.fetch_add(1, std::memory_order_relaxed);
+		return nullptr;
+	}
+
+	log_ring_buffer::record *rec;
+	while (!(rec = m_async->queue.try_claim(pos)))
+		std::this_thread::yield();
+	return rec;
+}
+
+logger::async_state::async_state(const logger_config &cfg) :
+	config(cfg),
+	queue(cfg.queue_size)
+{
+}
+
+logger::async_state::~async_state()
+{
+	stop.store(true);
+	queue.wake();
+	if (thread.joinable())
+		thread.join();
+}
+
+/*
+	Writes everything queued, and flushes the streams only once the queue is
+	empty, so bursts of messages cost a single flush. The thread only goes to
+	sleep after finding the queue empty once more, so producers keeping it
+	busy never have to wake it up, and blocked producers never wait for more
+	than a single pass.
+*/
+void logger::async_state::run()
+{
+	std::size_t reported = 0;
+	auto write = [this](const logger_message_style &style, std::chrono::steady_clock::time_point time, std::string_view s)
+	{
+		if (config.file_stream)
+		{
+			std::optional<std::scoped_lock<std::mutex>> lock;
+			if (auto mutex = config.file_stream_mutex)
+				lock.emplace(*mutex);
+			*config.file_stream << format_line(config, style, time, s, false) << '\n';
+		}
+
+		if (config.term_stream)
+		{
+			std::optional<std::scoped_lock<std::mutex>> lock;
+			if (auto mutex = config.term_stream_mutex)
+				lock.emplace(*mutex);
+			*config.term_stream << format_line(config, style, time, s, true) << '\n';
+		}
+	};
+
+	while (true)
+	{
+		bool stopping = stop.load();
+		bool written = false;
+		for (log_ring_buffer::record *rec; (rec = queue.front()); queue.pop())
+		{
+			write(*rec->style, rec->time, {rec->text.data(), rec->text.size()});
+			written = true;
+		}
+
+		auto dropped_now = dropped.load(std::memory_order_relaxed);
+		if (config.overflow == logger_overflow::count && dropped_now != reported)
+		{
+			write(logger_styles::warning, std::chrono::steady_clock::now(), fmt::format("{} messages dropped", dropped_now - reported));
+			reported = dropped_now;
+			written = true;
+		}
+
+		if (written)
+			for (auto [stream, mutex] : {std::pair{config.file_stream, config.file_stream_mutex}, {config.term_stream, config.term_stream_mutex}})
+				if (stream)
+				{
+					std::optional<std::scoped_lock<std::mutex>> lock;
+					if (mutex)
+						lock.emplace(*mutex);
+					stream->flush();
+				}
+
+		// Everything published before the stop has been written by now
+		if (stopping)
+			break;
+		if (!written)
+			queue.wait(stop);
+	}
+}
+
 namespace logger_styles
 {
 	const logger_message_style debug
@@ -3,7 +3,15 @@
 #include <mutex>
 #include <iosfwd>
 #include <fmt/core.h>
+#include <fmt/format.h>
 #include <chrono>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <iterator>
+#include <cstddef>
+#include <cstdint>
 
 struct logger_message_style
 {
@@ -12,6 +20,17 @@ struct logger_message_style
 	int message_color;
 };
 
+/*
+	What happens to messages logged while the queue of an asynchronous logger
+	is full.
+*/
+enum class logger_overflow
+{
+	block, //!< Wait until the background thread makes space
+	drop,  //!< Discard them
+	count, //!< Discard them, and report how many were lost in the log
+};
+
 struct logger_config
 {
 	std::chrono::time_point<std::chrono::steady_clock> ref_time;
@@ -19,30 +38,160 @@ struct logger_config
 	std::mutex *term_stream_mutex;
 	std::ostream *file_stream;
 	std::mutex *file_stream_mutex;
+
+	bool async = false;            //!< Write from a background thread - styles must outlive the logger
+	std::size_t queue_size = 4096; //!< Rounded up to a power of two
+	logger_overflow overflow = logger_overflow::block;
 };
 
-class logger
+/*
+	Bounded lock-free queue of log records, with many producers and a single
+	consumer. Each slot has a sequence number telling whose turn it is - the
+	producer claiming position p waits for it to be p, and publishes the
+	record by setting it to p + 1, which the consumer sets to p + size once
+	done. Messages are formatted into inline buffers of the records, so
+	logging only allocates for very long ones.
+*/
+class log_ring_buffer
 {
 public:
-	logger(logger_config cfg) :
-		m_config(std::move(cfg))
+	struct record
+	{
+		const logger_message_style *style;
+		std::chrono::steady_clock::time_point time;
+		fmt::basic_memory_buffer<char, 256> text;
+	};
+
+	explicit log_ring_buffer(std::size_t size);
+
+	//! Claims a slot for writing, or returns nullptr if the queue is full
+	record *try_claim(std::size_t &pos)
+	{
+		pos = m_tail.load(std::memory_order_relaxed);
+		while (true)
+		{
+			auto &s = m_slots[pos & m_mask];
+			auto diff = static_cast<std::intptr_t>(s.seq.load(std::memory_order_acquire) - pos);
+			if (diff == 0)
+			{
+				if (m_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+					return &s.rec;
+			}
+			else if (diff < 0)
+				return nullptr;
+			else
+				pos = m_tail.load(std::memory_order_relaxed);
+		}
+	}
+
+	void publish(std::size_t pos)
+	{
+		m_slots[pos & m_mask].seq.store(pos + 1, std::memory_order_release);
+
+		// Pairs with the fence in wait(), so either the consumer sees the record or we see it sleeping.
+		// Only the first producer to see it pays for waking it up.
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (m_sleeping.load(std::memory_order_relaxed) && m_sleeping.exchange(false, std::memory_order_relaxed))
+			wake();
+	}
+
+	//! Only called by the consumer
+	record *front()
+	{
+		auto &s = m_slots[m_head & m_mask];
+		return s.seq.load(std::memory_order_acquire) == m_head + 1 ? &s.rec : nullptr;
+	}
+
+	void pop()
 	{
+		m_slots[m_head & m_mask].seq.store(m_head + m_mask + 1, std::memory_order_release);
+		m_head++;
 	}
 
+	//! Sleeps until something is published, or stop is set
+	void wait(const std::atomic<bool> &stop);
+	void wake();
+
+private:
+	struct alignas(64) slot
+	{
+		std::atomic<std::size_t> seq;
+		record rec;
+	};
+
+	std::vector<slot> m_slots;
+	std::size_t m_mask;
+	alignas(64) std::atomic<std::size_t> m_tail{0};
+	alignas(64) std::size_t m_head = 0;
+
+	// Written by the producers too, so kept apart from the consumer's position
+	alignas(64) std::atomic<bool> m_sleeping{false};
+	std::atomic<std::uint32_t> m_signal{0};
+};
+
+class logger
+{
+public:
+	logger(logger_config cfg);
+
 	template <typename ...T>
 	void operator()(const logger_message_style &style, fmt::format_string<T...> f, T &&...args)
 	{
-		auto content = fmt::format(f, std::forward<T>(args)...);
-		if (m_config.file_stream) file_dispatch(style, content);
-		if (m_config.term_stream) term_dispatch(style, content);
+		if (!m_async)
+		{
+			auto content = fmt::format(f, std::forward<T>(args)...);
+			if (m_config.file_stream) file_dispatch(style, content);
+			if (m_config.term_stream) term_dispatch(style, content);
+			return;
+		}
+
+		std::size_t pos;
+		auto rec = m_async->queue.try_claim(pos);
+		if (!rec && !(rec = claim_slow(pos)))
+			return;
+
+		// The slot has to be published even if formatting fails, or the queue would get stuck
+		rec->style = &style;
+		rec->time = std::chrono::steady_clock::now();
+		rec->text.clear();
+		try
+		{
+			fmt::format_to(std::back_inserter(rec->text), f, std::forward<T>(args)...);
+		}
+		catch (...)
+		{
+			rec->text.clear();
+			m_async->queue.publish(pos);
+			throw;
+		}
+		m_async->queue.publish(pos);
 	}
 
+	//! Number of messages discarded due to a full queue
+	std::size_t dropped() const {return m_async ? m_async->dropped.load(std::memory_order_relaxed) : 0;}
+
 private:
+	// Shared by copies of the logger, the last one stops the thread
+	struct async_state
+	{
+		explicit async_state(const logger_config &cfg);
+		~async_state();
+		void run();
+
+		logger_config config;
+		log_ring_buffer queue;
+		std::atomic<std::size_t> dropped{0};
+		std::atomic<bool> stop{false};
+		std::thread thread;
+	};
+
 	std::string format_message(const logger_message_style &style, const std::string &s, bool colors = false);
 	void file_dispatch(const logger_message_style &style, const std::string &s);
 	void term_dispatch(const logger_message_style &style, const std::string &s);
+	log_ring_buffer::record *claim_slow(std::size_t &pos);
 
 	logger_config m_config;
+	std::shared_ptr<async_state> m_async;
 };
 
 namespace logger_styles
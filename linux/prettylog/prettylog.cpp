@@ -8,19 +8,21 @@
 
 int main(int argc, char *argv[])
 {
-	if (argc > 2)
+	bool async = argc > 1 && std::string{argv[1]} == "--async";
+	if (argc > 2 + async)
 	{
-		std::cerr << "Usage: " << argv[0] << " [output file]" << std::endl;
+		std::cerr << "Usage: " << argv[0] << " [--async] [output file]" << std::endl;
 		return 1;
 	}
 	
 	std::optional<std::ofstream> logfile;
-	if (argc > 1)
+	if (argc > 1 + async)
 	{
-		logfile = std::ofstream(argv[1]);
+		const char *path = argv[1 + async];
+		logfile = std::ofstream(path);
 		if (!logfile->good())
 		{
-			std::cerr << "Could not open '" << argv[1] << "' for writing!" << std::endl;
+			std::cerr << "Could not open '" << path << "' for writing!" << std::endl;
 			return 1;
 		}
 	}
@@ -30,6 +32,7 @@ int main(int argc, char *argv[])
 	log_config.ref_time = std::chrono::steady_clock::now();
 	log_config.term_stream = &std::cerr;
 	log_config.file_stream = logfile.has_value() ? &*logfile : nullptr;
+	log_config.async = async;
 	logger log(log_config);
 	
 	std::string line;
@@ -0,0 +1,29 @@
+#include "alloc_counter.hpp"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+static std::atomic<std::size_t> allocations{0};
+
+std::size_t heap_allocations()
+{
+	return allocations.load(std::memory_order_relaxed);
+}
+
+void *operator new(std::size_t size)
+{
+	allocations.fetch_add(1, std::memory_order_relaxed);
+	if (auto p = std::malloc(size ? size : 1))
+		return p;
+	throw std::bad_alloc{};
+}
+
+void operator delete(void *p) noexcept
+{
+	std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept
+{
+	std::free(p);
+}
@@ -0,0 +1,9 @@
+#pragma once
+#include <cstddef>
+
+/*
+	Number of heap allocations made by the program so far. Only available in
+	programs linked with alloc_counter.cpp, which replaces the global
+	operator new for counting them.
+*/
+std::size_t heap_allocations();
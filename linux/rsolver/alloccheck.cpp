@@ -0,0 +1,78 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include "alloc_counter.hpp"
+#include "circuit.hpp"
+#include "program.hpp"
+#include "search.hpp"
+#include "series.hpp"
+#include "strategy.hpp"
+
+/*
+	Checks that the restart search loop doesn't allocate once it has reached
+	a steady state. The search is run single-threaded, with a fixed seed, for
+	a target which is easily matched exactly - but it doesn't stop there, so
+	it keeps finding other solutions as good as the first. It's run once for
+	a number of generations, and once for ten times as many. Everything done
+	before the best solution is found is identical in both runs, so any
+	difference in the number of heap allocations comes from the additional
+	steady-state generations.
+*/
+
+struct run_result
+{
+	size_t allocations;
+	size_t generations;
+	size_t improvements;
+};
+
+static run_result run(const circuit_program &prog, const std::vector<float> &avail, search_config cfg)
+{
+	range target{1000.f, 1000.f};
+	size_t improvements = 0;
+	size_t before = heap_allocations();
+	auto summary = restart_search(prog, avail, target, cfg, [&](const search_report &){improvements++;});
+	return {heap_allocations() - before, summary.generations, improvements};
+}
+
+int main()
+{
+	auto circuit = str_to_circuit("(r[rr][rr])");
+	auto prog = compile_circuit(*circuit);
+	auto avail = make_eseries_values("E12", 0, 5);
+	
+	bool ok = true;
+	for (const auto &name : get_strategy_names())
+		for (bool rescore : {false, true})
+		{
+			search_config cfg;
+			cfg.strategy = name;
+			cfg.seed = 1;
+			cfg.stop_score = 1;
+			if (rescore)
+				cfg.rescore = [](const solution &sol){return sol.score;};
+			
+			// Static state is set up in the first search, which isn't measured
+			cfg.max_evals = 500000;
+			run(prog, avail, cfg);
+			auto short_run = run(prog, avail, cfg);
+			cfg.max_evals *= 10;
+			auto long_run = run(prog, avail, cfg);
+			
+			auto label = name + (rescore ? " (rescored)" : "");
+			if (short_run.improvements != long_run.improvements)
+			{
+				std::cout << label << ": the best solution wasn't found in the shorter run" << std::endl;
+				ok = false;
+				continue;
+			}
+			
+			auto extra = std::ptrdiff_t(long_run.allocations) - std::ptrdiff_t(short_run.allocations);
+			std::cout << label << ": " << extra << " allocations in " << long_run.generations - short_run.generations
+				<< " steady-state generations" << std::endl;
+			ok = ok && extra == 0;
+		}
+	
+	std::cout << (ok ? "OK" : "FAILED") << std::endl;
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,113 @@
+#include "batch.hpp"
+#include "specialized.hpp"
+
+/*
+	The kernel is force-inlined into functions compiled for different targets,
+	so the lane loops get vectorized with the widest available instruction set.
+*/
+template <size_t W>
+[[gnu::always_inline]] inline void eval_batch(const circuit_program &prog, const float *values, float *out_lo, float *out_hi)
+{
+	alignas(64) float lo[program_max_stack][W];
+	alignas(64) float hi[program_max_stack][W];
+	size_t sp = 0;
+	const std::uint32_t *slot = prog.slots.data();
+	const range *constant = prog.constants.data();
+	
+	for (auto op : prog.ops)
+	{
+		switch (op)
+		{
+			case opcode::leaf:
+			{
+				auto s = *slot++;
+				float lo_scale = 1.f - prog.tols[s];
+				float hi_scale = 1.f + prog.tols[s];
+				const float *v = values + s * W;
+				for (auto l = 0u; l < W; l++)
+				{
+					lo[sp][l] = lo_scale * v[l];
+					hi[sp][l] = hi_scale * v[l];
+				}
+				sp++;
+				break;
+			}
+			
+			case opcode::constant:
+				for (auto l = 0u; l < W; l++)
+				{
+					lo[sp][l] = constant->first;
+					hi[sp][l] = constant->second;
+				}
+				constant++;
+				sp++;
+				break;
+			
+			case opcode::serial:
+				sp--;
+				for (auto l = 0u; l < W; l++)
+				{
+					lo[sp - 1][l] += lo[sp][l];
+					hi[sp - 1][l] += hi[sp][l];
+				}
+				break;
+			
+			case opcode::parallel:
+				sp--;
+				for (auto l = 0u; l < W; l++)
+				{
+					lo[sp - 1][l] = parallel2(lo[sp - 1][l], lo[sp][l]);
+					hi[sp - 1][l] = parallel2(hi[sp - 1][l], hi[sp][l]);
+				}
+				break;
+		}
+	}
+	
+	for (auto l = 0u; l < W; l++)
+	{
+		out_lo[l] = lo[0][l];
+		out_hi[l] = hi[0][l];
+	}
+}
+
+static void eval_batch_generic(const circuit_program &prog, const float *values, float *lo, float *hi)
+{
+	eval_batch<batch_lanes>(prog, values, lo, hi);
+}
+
+[[gnu::target("avx2,fma")]]
+static void eval_batch_avx2(const circuit_program &prog, const float *values, float *lo, float *hi)
+{
+	eval_batch<batch_lanes>(prog, values, lo, hi);
+}
+
+[[gnu::target("avx512f")]]
+static void eval_batch_avx512(const circuit_program &prog, const float *values, float *lo, float *hi)
+{
+	eval_batch<batch_lanes>(prog, values, lo, hi);
+}
+
+std::vector<batch_kernel> get_supported_batch_kernels()
+{
+	std::vector<batch_kernel> kernels{{"generic", eval_batch_generic}};
+	
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+		kernels.push_back({"avx2", eval_batch_avx2});
+	if (__builtin_cpu_supports("avx512f"))
+		kernels.push_back({"avx512", eval_batch_avx512});
+	
+	return kernels;
+}
+
+batch_kernel get_batch_kernel()
+{
+	static const batch_kernel kernel = get_supported_batch_kernels().back();
+	return kernel;
+}
+
+batch_kernel get_batch_kernel(const circuit_program &prog)
+{
+	auto kernel = find_specialized_kernel(prog);
+	return kernel ? *kernel : get_batch_kernel();
+}
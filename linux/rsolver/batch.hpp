@@ -0,0 +1,23 @@
+#pragma once
+#include <vector>
+#include "program.hpp"
+
+constexpr size_t batch_lanes = 16;
+
+/*
+	Evaluates batch_lanes value assignments at once. The values are laid out
+	as structure of arrays - batch_lanes consecutive values for each slot.
+*/
+using batch_eval_fn = void (*)(const circuit_program &prog, const float *values, float *lo, float *hi);
+
+struct batch_kernel
+{
+	const char *name;
+	batch_eval_fn eval;
+};
+
+std::vector<batch_kernel> get_supported_batch_kernels();
+batch_kernel get_batch_kernel();
+
+//! Kernel specialized for the circuit if there's one, or the generic one
+batch_kernel get_batch_kernel(const circuit_program &prog);
@@ -0,0 +1,270 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+#include <functional>
+#include <sstream>
+#include <cmath>
+#include "alloc_counter.hpp"
+#include "circuit.hpp"
+#include "program.hpp"
+#include "incremental.hpp"
+#include "batch.hpp"
+#include "search.hpp"
+#include "series.hpp"
+#include "specialized.hpp"
+#include "netlist.hpp"
+#include "impedance.hpp"
+#include "divider.hpp"
+
+/*
+	Microbenchmark of the evaluators - measures how many single-resistor
+	changes (hill climbing candidates) can be evaluated per second, starting
+	with the virtual resistance hierarchy. Circuits with a specialized kernel
+	are evaluated with it as well, and so are a few non-series-parallel
+	networks with nodal analysis, an RLC circuit at sweeps of frequencies, and
+	divider chains, with and without the shared prefix sums. Local
+	searches are measured in restarts per second, along with the number of
+	heap allocations per restart, which should be zero.
+*/
+
+struct candidate
+{
+	size_t slot;
+	float value;
+};
+
+static double measure(const std::function<void()> &f, size_t candidates_per_call)
+{
+	using clock = std::chrono::steady_clock;
+	size_t calls = 0;
+	auto t0 = clock::now();
+	auto t1 = t0;
+	do
+	{
+		for (int i = 0; i < 100; i++)
+			f();
+		calls += 100;
+		t1 = clock::now();
+	} while (t1 - t0 < std::chrono::milliseconds(300));
+	
+	return calls * candidates_per_call / std::chrono::duration<double>(t1 - t0).count();
+}
+
+//! Netlist of an n by n grid of resistors, measured between opposite corners
+static std::string make_grid(int n)
+{
+	std::stringstream ss;
+	ss << ".port n0_0 n" << n << "_" << n << "\n";
+	for (int y = 0; y <= n; y++)
+		for (int x = 0; x <= n; x++)
+		{
+			if (x < n) ss << "R" << y << "_" << x << "h n" << y << "_" << x << " n" << y << "_" << x + 1 << "\n";
+			if (y < n) ss << "R" << y << "_" << x << "v n" << y << "_" << x << " n" << y + 1 << "_" << x << "\n";
+		}
+	return ss.str();
+}
+
+static std::string make_ladder(int n)
+{
+	std::string s;
+	for (int i = 0; i < n; i++)
+		s += i % 2 ? "[r" : "(r";
+	s += "r";
+	for (int i = n - 1; i >= 0; i--)
+		s += i % 2 ? "]" : ")";
+	return s;
+}
+
+int main(int argc, char *argv[])
+{
+	std::vector<std::string> circuits{"(r[rr][rr])", "(r[r(rr)][rr]r[rr])", make_ladder(16), make_ladder(64)};
+	for (int i = 1; i < argc; i++)
+		circuits.push_back(argv[i]);
+	
+	std::mt19937 rng{42};
+	std::uniform_real_distribution<float> dist(1.f, 1e5f);
+	volatile float sink;
+	
+	auto avail = make_eseries_values("E24", 0, 5);
+	
+	for (const auto &desc : circuits)
+	{
+		auto circuit = str_to_circuit(desc);
+		auto prog = compile_circuit(*circuit);
+		
+		std::vector<float> values(prog.size());
+		for (auto &v : values)
+			v = dist(rng);
+		
+		std::vector<candidate> cands;
+		for (auto i = 0u; i < values.size(); i++)
+		{
+			cands.push_back({i, values[i] * 0.9f});
+			cands.push_back({i, values[i] * 1.1f});
+		}
+		
+		std::cout << desc << " (" << prog.size() << " resistors, " << cands.size() << " candidates)" << std::endl;
+		auto report = [](const std::string &name, double rate)
+		{
+			std::cout << "\t" << std::setw(20) << std::left << name << std::fixed << std::setprecision(2) << rate / 1e6 << " M candidates/s" << std::endl;
+		};
+		
+		auto res = circuit->get_resistances();
+		for (auto i = 0u; i < res.size(); i++)
+			*res[i] = values[i];
+		report("virtual", measure([&]{
+			for (const auto &c : cands)
+			{
+				float old = *res[c.slot];
+				*res[c.slot] = c.value;
+				sink = circuit->est_min();
+				sink = circuit->est_max();
+				*res[c.slot] = old;
+			}
+		}, cands.size()));
+		
+		report("program", measure([&]{
+			for (const auto &c : cands)
+			{
+				float old = values[c.slot];
+				values[c.slot] = c.value;
+				sink = prog.eval(values.data()).first;
+				values[c.slot] = old;
+			}
+		}, cands.size()));
+		
+		incremental_circuit circ(prog);
+		circ.set(values.data());
+		report("incremental", measure([&]{
+			for (const auto &c : cands)
+				sink = circ.probe(c.slot, c.value).first;
+		}, cands.size()));
+		
+		std::vector<float> batch_values(prog.size() * batch_lanes);
+		alignas(64) float lo[batch_lanes];
+		alignas(64) float hi[batch_lanes];
+		std::vector<std::pair<std::string, batch_kernel>> kernels;
+		for (const auto &kernel : get_supported_batch_kernels())
+			kernels.push_back({"batch-" + std::string{kernel.name}, kernel});
+		if (auto kernel = find_specialized_kernel(prog))
+			kernels.push_back({kernel->name, *kernel});
+		
+		for (const auto &[name, kernel] : kernels)
+		{
+			report(name, measure([&]{
+				for (auto i = 0u; i < values.size(); i++)
+					std::fill_n(&batch_values[i * batch_lanes], batch_lanes, values[i]);
+				
+				for (auto b = 0u; b < cands.size(); b += batch_lanes)
+				{
+					auto n = std::min(batch_lanes, cands.size() - b);
+					for (auto l = 0u; l < n; l++)
+						batch_values[cands[b + l].slot * batch_lanes + l] = cands[b + l].value;
+					
+					kernel.eval(prog, batch_values.data(), lo, hi);
+					sink = lo[0];
+					
+					for (auto l = 0u; l < n; l++)
+						batch_values[cands[b + l].slot * batch_lanes + l] = values[cands[b + l].slot];
+				}
+			}, cands.size()));
+		}
+		
+		local_search ls(prog, avail, {1234.5f, 1234.5f});
+		std::uniform_int_distribution<size_t> index_dist(0, avail.size() - 1);
+		std::vector<size_t> indices(prog.size());
+		for (auto steepest : {false, true})
+		{
+			auto restart = [&]{
+				for (auto &i : indices)
+					i = index_dist(rng);
+				sink = steepest ? ls.hill_climb(indices.data()).score : ls.coordinate_descent(indices.data()).score;
+			};
+			
+			// Buffers only grow during the first restarts
+			for (int i = 0; i < 100; i++)
+				restart();
+			
+			size_t before = heap_allocations();
+			size_t restarts = 0;
+			double rate = measure([&]{restart(); restarts++;}, 1);
+			double allocs = double(heap_allocations() - before) / restarts;
+			
+			std::cout << "\t" << std::setw(20) << std::left << (steepest ? "steepest" : "coordinate") << std::fixed << std::setprecision(2)
+				<< rate / 1e3 << " k restarts/s, " << allocs << " allocations/restart" << std::endl;
+		}
+	}
+	
+	// Each candidate is a full numeric factorization
+	for (int n : {1, 4, 8})
+	{
+		std::stringstream ss{make_grid(n)};
+		netlist net(ss);
+		nodal_evaluator eval(net);
+		
+		std::vector<float> values(net.size());
+		for (auto &v : values)
+			v = dist(rng);
+		
+		std::cout << n << "x" << n << " grid netlist (" << net.size() << " resistors, " << eval.nonzeros() << " factor entries)" << std::endl;
+		std::cout << "\t" << std::setw(20) << std::left << "nodal" << std::fixed << std::setprecision(2)
+			<< measure([&]{sink = eval.eval(values.data());}, 1) / 1e6 << " M evals/s" << std::endl;
+	}
+	
+	// A single frequency costs as much as a whole block
+	auto rlc = compile_circuit(*str_to_circuit("(r[r C][r L])"));
+	std::vector<float> rlc_values{1e3f, 2.2e3f, 1e-7f, 4.7e3f, 1e-2f};
+	std::cout << "(r[r C][r L]) impedance" << std::endl;
+	for (size_t n : {size_t(1), batch_lanes, 4 * batch_lanes})
+	{
+		std::vector<float> frequencies(n), re(n), im(n);
+		for (auto i = 0u; i < n; i++)
+			frequencies[i] = 10.f * std::pow(1.2f, i);
+		
+		impedance_evaluator zeval(rlc, frequencies);
+		std::cout << "\t" << std::setw(20) << std::left << (std::to_string(n) + " frequencies") << std::fixed << std::setprecision(2)
+			<< measure([&]{zeval.eval(rlc_values.data(), re.data(), im.data()); sink = re[0];}, n) / 1e6 << " M points/s" << std::endl;
+	}
+	
+	// A full evaluation is a pass over the whole chain, a probe only over the taps
+	for (size_t taps : {4, 16, 64})
+	{
+		std::vector<float> ratios(taps), tap_values(taps);
+		for (auto i = 0u; i < taps; i++)
+			ratios[i] = (i + 1.f) / (taps + 1);
+		divider_chain chain(ratios, 2);
+		divider_evaluator eval(chain);
+		
+		std::vector<float> values(chain.size());
+		for (auto &v : values)
+			v = dist(rng);
+		eval.set(values.data());
+		
+		std::cout << taps << "-tap divider (" << chain.size() << " resistors)" << std::endl;
+		auto report = [](const std::string &name, double rate)
+		{
+			std::cout << "\t" << std::setw(20) << std::left << name << std::fixed << std::setprecision(2) << rate / 1e6 << " M candidates/s" << std::endl;
+		};
+		
+		report("full", measure([&]{
+			for (auto i = 0u; i < values.size(); i++)
+			{
+				float old = values[i];
+				values[i] = old * 1.1f;
+				chain.taps(values.data(), tap_values.data());
+				sink = divider_score(chain, tap_values.data());
+				values[i] = old;
+			}
+		}, values.size()));
+		
+		report("prefix", measure([&]{
+			for (auto i = 0u; i < values.size(); i++)
+				sink = eval.probe(i, values[i] * 1.1f);
+		}, values.size()));
+	}
+	
+	return 0;
+}
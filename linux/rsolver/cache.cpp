@@ -0,0 +1,317 @@
+#include "cache.hpp"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+struct solution_cache::header
+{
+	char magic[8];
+	std::uint32_t version;
+	std::uint32_t entry_size;
+	std::uint64_t capacity; //!< Power of two
+	std::uint64_t count;
+	char padding[224];
+};
+
+struct solution_cache::entry
+{
+	std::uint32_t seq;   //!< Odd while being written
+	std::uint32_t flags; //!< See below
+	std::uint64_t hash;  //!< Of the whole key
+	float lo, hi;
+	float score;
+	float padding;
+	std::uint64_t check; //!< Second, independent digest of the whole key
+	char desc[216];      //!< Null-terminated
+	
+	static constexpr std::uint32_t used = 1;
+	static constexpr std::uint32_t optimal = 2;
+};
+
+static constexpr char cache_magic[8] = {'R', 'S', 'C', 'A', 'C', 'H', 'E', 0};
+static constexpr std::uint32_t cache_version = 3;
+static constexpr std::uint64_t cache_initial_capacity = 1024;
+
+static std::uint64_t fnv1a(const void *data, size_t size, std::uint64_t h = 14695981039346656037ull)
+{
+	auto p = static_cast<const unsigned char*>(data);
+	for (size_t i = 0; i < size; i++)
+		h = (h ^ p[i]) * 1099511628211ull;
+	return h;
+}
+
+static std::string key_bytes(const cache_key &key)
+{
+	std::string s = key.circuit;
+	s += '\0';
+	s += key.values;
+	s += '\0';
+	s.append(reinterpret_cast<const char*>(&key.target), sizeof(key.target));
+	return s;
+}
+
+static std::uint64_t key_hash(const std::string &bytes)
+{
+	auto h = fnv1a(bytes.data(), bytes.size());
+	
+	// Zero marks empty entries
+	return h ? h : 1;
+}
+
+// Multiply-xorshift over 8-byte words, with the splitmix64 finalizer - unrelated
+// to FNV-1a, so keys colliding in both digests are practically impossible
+static std::uint64_t key_check(const std::string &bytes)
+{
+	std::uint64_t h = bytes.size() * 0x9e3779b97f4a7c15ull;
+	for (size_t i = 0; i < bytes.size(); i += 8)
+	{
+		std::uint64_t w = 0;
+		std::memcpy(&w, bytes.data() + i, std::min<size_t>(8, bytes.size() - i));
+		h = (h ^ w) * 0xbf58476d1ce4e5b9ull;
+		h ^= h >> 31;
+	}
+	
+	h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ull;
+	h = (h ^ (h >> 27)) * 0x94d049bb133111ebull;
+	return h ^ (h >> 31);
+}
+
+std::string canonical_form(const resistance &circuit)
+{
+	auto block = dynamic_cast<const resistance_block*>(&circuit);
+	if (!block)
+		return circuit.structure();
+	
+	std::vector<std::string> children;
+	for (const auto &r : block->resistances)
+		children.push_back(canonical_form(*r));
+	std::sort(children.begin(), children.end());
+	
+	bool is_parallel = dynamic_cast<const parallel*>(&circuit);
+	std::string s = is_parallel ? "[" : "(";
+	for (const auto &c : children)
+		s += c;
+	return s + (is_parallel ? "]" : ")");
+}
+
+std::string values_id(const std::vector<float> &avail)
+{
+	static const char digits[] = "0123456789abcdef";
+	auto h = fnv1a(avail.data(), avail.size() * sizeof(float));
+	std::string s;
+	for (int i = 60; i >= 0; i -= 4)
+		s += digits[(h >> i) & 15];
+	return s;
+}
+
+solution_cache::solution_cache(const std::string &path) :
+	m_path(path)
+{
+	// The header takes the place of one entry
+	static_assert(sizeof(header) == 256 && sizeof(entry) == 256);
+	map();
+}
+
+solution_cache::~solution_cache()
+{
+	unmap();
+}
+
+void solution_cache::map()
+{
+	m_fd = open(m_path.c_str(), O_RDWR | O_CREAT, 0644);
+	if (m_fd < 0)
+		throw std::runtime_error{"could not open cache " + m_path};
+	
+	// Only one process initializes a new file
+	flock(m_fd, LOCK_EX);
+	struct stat st;
+	fstat(m_fd, &st);
+	if (st.st_size == 0)
+	{
+		header h{};
+		std::memcpy(h.magic, cache_magic, sizeof(cache_magic));
+		h.version = cache_version;
+		h.entry_size = sizeof(entry);
+		h.capacity = cache_initial_capacity;
+		if (ftruncate(m_fd, sizeof(header) + h.capacity * sizeof(entry)) || pwrite(m_fd, &h, sizeof(h), 0) != sizeof(h))
+		{
+			flock(m_fd, LOCK_UN);
+			throw std::runtime_error{"could not initialize cache " + m_path};
+		}
+		fstat(m_fd, &st);
+	}
+	flock(m_fd, LOCK_UN);
+	
+	m_size = st.st_size;
+	m_data = mmap(nullptr, m_size, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+	if (m_data == MAP_FAILED)
+	{
+		m_data = nullptr;
+		throw std::runtime_error{"could not map cache " + m_path};
+	}
+	
+	auto h = static_cast<const header*>(m_data);
+	if (std::memcmp(h->magic, cache_magic, sizeof(cache_magic)) || h->version != cache_version || h->entry_size != sizeof(entry)
+		|| m_size != sizeof(header) + h->capacity * sizeof(entry))
+		throw std::runtime_error{"invalid cache " + m_path};
+}
+
+void solution_cache::unmap()
+{
+	if (m_data)
+		munmap(m_data, m_size);
+	if (m_fd >= 0)
+		close(m_fd);
+	m_data = nullptr;
+	m_fd = -1;
+}
+
+// Linear probing - returns the matching entry, or the empty one ending the chain
+solution_cache::entry *solution_cache::probe(std::uint64_t hash, std::uint64_t check) const
+{
+	auto h = static_cast<header*>(m_data);
+	auto entries = reinterpret_cast<entry*>(h + 1);
+	auto mask = h->capacity - 1;
+	for (auto i = hash & mask;; i = (i + 1) & mask)
+	{
+		auto &e = entries[i];
+		if (!(__atomic_load_n(&e.flags, __ATOMIC_ACQUIRE) & entry::used))
+			return &e;
+		if (e.hash == hash && e.check == check)
+			return &e;
+	}
+}
+
+std::optional<cached_solution> solution_cache::find(const cache_key &key) const
+{
+	std::shared_lock lock{m_mutex};
+	auto bytes = key_bytes(key);
+	auto hash = key_hash(bytes), check = key_check(bytes);
+	auto e = probe(hash, check);
+	
+	// Copy the entry until it isn't changed in the meantime
+	entry copy;
+	std::uint32_t seq;
+	do
+	{
+		while ((seq = __atomic_load_n(&e->seq, __ATOMIC_ACQUIRE)) & 1);
+		std::memcpy(&copy, e, sizeof(copy));
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	} while (__atomic_load_n(&e->seq, __ATOMIC_RELAXED) != seq);
+	
+	if (!(copy.flags & entry::used) || copy.hash != hash || copy.check != check)
+		return std::nullopt;
+	
+	copy.desc[sizeof(copy.desc) - 1] = 0;
+	return cached_solution{{copy.lo, copy.hi}, copy.score, bool(copy.flags & entry::optimal), copy.desc};
+}
+
+void solution_cache::store(const cache_key &key, const cached_solution &sol)
+{
+	if (sol.desc.size() >= sizeof(entry::desc))
+		return;
+	
+	std::unique_lock lock{m_mutex};
+	lock_file();
+	while ((static_cast<header*>(m_data)->count + 1) * 2 > static_cast<header*>(m_data)->capacity)
+	{
+		grow();
+		lock_file();
+	}
+	
+	auto h = static_cast<header*>(m_data);
+	auto bytes = key_bytes(key);
+	auto hash = key_hash(bytes), check = key_check(bytes);
+	auto e = probe(hash, check);
+	bool is_new = !(e->flags & entry::used);
+	bool better = is_new
+		|| (sol.optimal && !(e->flags & entry::optimal))
+		|| (sol.optimal == bool(e->flags & entry::optimal) && sol.score > e->score);
+	
+	if (better)
+	{
+		__atomic_store_n(&e->seq, e->seq + 1, __ATOMIC_RELAXED);
+		__atomic_thread_fence(__ATOMIC_RELEASE);
+		e->hash = hash;
+		e->check = check;
+		e->lo = sol.rg.first;
+		e->hi = sol.rg.second;
+		e->score = sol.score;
+		std::memset(e->desc, 0, sizeof(e->desc));
+		std::memcpy(e->desc, sol.desc.data(), sol.desc.size());
+		__atomic_store_n(&e->flags, entry::used | (sol.optimal ? entry::optimal : 0), __ATOMIC_RELEASE);
+		__atomic_store_n(&e->seq, e->seq + 1, __ATOMIC_RELEASE);
+		if (is_new)
+			h->count++;
+	}
+	
+	flock(m_fd, LOCK_UN);
+}
+
+void solution_cache::lock_file()
+{
+	// Another process could have replaced the file in the meantime
+	flock(m_fd, LOCK_EX);
+	struct stat mapped, current;
+	while (fstat(m_fd, &mapped) == 0 && stat(m_path.c_str(), &current) == 0 && current.st_ino != mapped.st_ino)
+	{
+		flock(m_fd, LOCK_UN);
+		unmap();
+		map();
+		flock(m_fd, LOCK_EX);
+	}
+}
+
+// Called with the file locked, releases the lock
+void solution_cache::grow()
+{
+	auto old = static_cast<const header*>(m_data);
+	auto old_entries = reinterpret_cast<const entry*>(old + 1);
+	
+	header h = *old;
+	h.capacity *= 2;
+	std::vector<entry> entries(h.capacity);
+	for (size_t i = 0; i < old->capacity; i++)
+	{
+		const auto &e = old_entries[i];
+		if (!(e.flags & entry::used))
+			continue;
+		
+		auto j = e.hash & (h.capacity - 1);
+		while (entries[j].flags & entry::used)
+			j = (j + 1) & (h.capacity - 1);
+		entries[j] = e;
+	}
+	
+	// The new table is complete before it replaces the old one
+	auto tmp = m_path + ".tmp" + std::to_string(getpid());
+	int fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	size_t bytes = entries.size() * sizeof(entry);
+	bool ok = fd >= 0
+		&& write(fd, &h, sizeof(h)) == sizeof(h)
+		&& write(fd, entries.data(), bytes) == ssize_t(bytes)
+		&& fsync(fd) == 0;
+	if (fd >= 0)
+		close(fd);
+	if (!ok || rename(tmp.c_str(), m_path.c_str()))
+	{
+		unlink(tmp.c_str());
+		throw std::runtime_error{"could not grow cache " + m_path};
+	}
+	
+	// The lock on the old file is released with it
+	unmap();
+	map();
+}
+
+size_t solution_cache::size() const
+{
+	std::shared_lock lock{m_mutex};
+	return static_cast<const header*>(m_data)->count;
+}
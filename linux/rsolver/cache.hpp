@@ -0,0 +1,73 @@
+#pragma once
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <vector>
+#include "circuit.hpp"
+
+struct cache_key
+{
+	std::string circuit; //!< See canonical_form()
+	std::string values;  //!< See values_id()
+	float target;
+};
+
+struct cached_solution
+{
+	range rg;
+	float score;
+	bool optimal; //!< Proven optimal, rather than just the best one known
+	std::string desc;
+};
+
+//! Circuit description independent of the order of children and of the notation
+std::string canonical_form(const resistance &circuit);
+
+//! Hash of the available values, identifying the series and decades
+std::string values_id(const std::vector<float> &avail);
+
+/*
+	Persistent cache of solutions, shared by all runs (and processes) using
+	the same file. The file is an open-addressing hash table of fixed-size
+	entries, memory-mapped, so a lookup is just a few reads of the page cache.
+	
+	Writers hold an exclusive lock on the file. Entries are published with a
+	sequence number (odd while the entry is being written), so that readers
+	never see a torn entry and don't have to lock anything. Once the table is
+	half full, it's rebuilt twice as large in a temporary file, which atomically
+	replaces the old one - processes still reading the old one switch to the new
+	one with their next write.
+*/
+class solution_cache
+{
+public:
+	explicit solution_cache(const std::string &path);
+	~solution_cache();
+	solution_cache(const solution_cache &) = delete;
+	solution_cache &operator=(const solution_cache &) = delete;
+	
+	std::optional<cached_solution> find(const cache_key &key) const;
+	
+	//! Keeps the better solution - proven optimal ones first, then by score
+	void store(const cache_key &key, const cached_solution &sol);
+	
+	size_t size() const;
+
+private:
+	struct header;
+	struct entry;
+	
+	void map();
+	void unmap();
+	void lock_file(); //!< Exclusively, remapping the file if it was replaced
+	void grow();
+	entry *probe(std::uint64_t hash, std::uint64_t check) const;
+	
+	std::string m_path;
+	int m_fd = -1;
+	void *m_data = nullptr;
+	size_t m_size = 0;
+	mutable std::shared_mutex m_mutex; //!< Between threads - the file lock only works between processes
+};
@@ -0,0 +1,310 @@
+#include "circuit.hpp"
+#include "program.hpp"
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cmath>
+#include <map>
+#include <stdexcept>
+
+std::string to_si_string(float x)
+{
+	if (x == 0)
+		return "0";
+	
+	int e = std::floor(std::log10(std::abs(x)));
+	int i = std::clamp((e < 0 ? e - 2 : e) / 3 + 4, 0, 7);
+	static const char *prefixes[] = {"p", "n", "u", "m", "", "k", "M", "G"};
+	static const int exps[] = {-12, -9, -6, -3, 0, 3, 6, 9};
+	
+	std::stringstream ss;
+	ss << x / std::pow(10, exps[i]) << prefixes[i];
+	return ss.str();
+}
+
+float from_si_string(const std::string &s)
+{
+	static const std::array<std::string, 7> prefixes = {"p", "n", "u", "m", "k", "M", "G"};
+	static const std::array<int, 7> exps = {-12, -9, -6, -3, 3, 6, 9};
+	
+	std::istringstream ss(s);
+	float base;
+	ss >> base;
+	
+	std::string sexp;
+	std::getline(ss, sexp);
+	int e = 0;
+	
+	if (!sexp.empty())
+	{
+// 		std::cout << "sexp: '" << sexp << "'" << std::endl;
+		bool match = false;
+		for (auto i = 0u; i < prefixes.size(); i++)
+			if (sexp == prefixes[i])
+			{
+				e = exps[i];
+				match = true;
+				break;
+			}
+		
+		if (!match)
+			throw std::runtime_error{"invalid SI prefix"};
+	}
+	
+	return base * std::pow(10, e);
+}
+
+std::string resistor::describe() const
+{
+	static const char *units[] = {"", "F", "H"};
+	return to_si_string(get_value()) + units[static_cast<int>(kind)];
+}
+
+void resistor::compile(circuit_program &prog) const
+{
+	if (fixed)
+	{
+		prog.ops.push_back(opcode::constant);
+		prog.constants.push_back(est_range());
+		prog.constant_kinds.push_back(kind);
+		return;
+	}
+	
+	// The leader of a matched group always comes first
+	if (!leader)
+	{
+		slot = prog.tols.size();
+		prog.tols.push_back(tol);
+		prog.kinds.push_back(kind);
+	}
+	
+	prog.ops.push_back(opcode::leaf);
+	prog.slots.push_back(leader ? leader->slot : slot);
+}
+
+std::string resistor::structure() const
+{
+	// Matched resistors can't be swapped with others
+	std::string kind_id(1, "RCL"[static_cast<int>(kind)]);
+	if (fixed)
+		return "=" + kind_id + std::to_string(value) + "/" + std::to_string(tol);
+	else if (group)
+		return (leader ? "m" : "rm") + std::string{group};
+	else
+		return "r" + kind_id + std::to_string(tol);
+}
+
+/*
+	N-ary blocks are lowered into balanced trees of binary operations, so that
+	the evaluation stack (and paths from leaves to the root) only grow
+	logarithmically with the number of children.
+*/
+static void compile_block(circuit_program &prog, const std::pmr::vector<std::shared_ptr<resistance>> &v, size_t begin, size_t end, opcode op)
+{
+	if (end - begin == 1)
+	{
+		v[begin]->compile(prog);
+		return;
+	}
+	
+	auto mid = begin + (end - begin) / 2;
+	compile_block(prog, v, begin, mid, op);
+	compile_block(prog, v, mid, end, op);
+	prog.ops.push_back(op);
+}
+
+std::string resistance_block::children_structure() const
+{
+	std::string s;
+	for (const auto &r : resistances)
+		s += r->structure();
+	return s;
+}
+
+/*
+	Identical siblings can be swapped without changing the circuit, so only
+	assignments with the leaf values of such siblings in lexicographic order
+	need to be searched. Each sibling is ordered against the next identical one.
+	Siblings containing matched resistors are skipped, as their slots are
+	shared with other subtrees. Must be called before the children are compiled.
+*/
+void resistance_block::add_symmetries(circuit_program &prog) const
+{
+	std::vector<std::string> structures;
+	std::vector<std::uint32_t> firsts;
+	std::uint32_t first = prog.tols.size();
+	for (const auto &r : resistances)
+	{
+		structures.push_back(r->structure());
+		firsts.push_back(first);
+		first += std::count(structures.back().begin(), structures.back().end(), 'r');
+	}
+	
+	for (auto i = 0u; i < structures.size(); i++)
+	{
+		if (structures[i].find('m') != std::string::npos)
+			continue;
+		
+		for (auto j = i + 1; j < structures.size(); j++)
+			if (structures[j] == structures[i])
+			{
+				std::uint32_t length = firsts[i + 1] - firsts[i];
+				prog.symmetries.push_back({firsts[i], firsts[j], length});
+				break;
+			}
+	}
+}
+
+void parallel::compile(circuit_program &prog) const
+{
+	add_symmetries(prog);
+	compile_block(prog, resistances, 0, resistances.size(), opcode::parallel);
+}
+
+void serial::compile(circuit_program &prog) const
+{
+	add_symmetries(prog);
+	compile_block(prog, resistances, 0, resistances.size(), opcode::serial);
+}
+
+std::unique_ptr<resistance> par(std::vector<std::shared_ptr<resistance>> l)
+{
+	auto ptr = std::make_unique<parallel>();
+	ptr->resistances.assign(l.begin(), l.end());
+	return ptr;
+}
+
+std::unique_ptr<resistance> ser(std::initializer_list<std::shared_ptr<resistance>> l)
+{
+	auto ptr = std::make_unique<serial>();
+	ptr->resistances.assign(l.begin(), l.end());
+	return ptr;
+}
+
+std::unique_ptr<resistance> res(float r, float tol)
+{
+	auto ptr = std::make_unique<resistor>();
+	ptr->value = r;
+	ptr->tol = tol;
+	return ptr;
+}
+
+float range_score(const range &target, const range &r)
+{
+	return -std::abs(target.first - r.first) - std::abs(target.second - r.second);
+}
+
+template <typename T, typename... Args>
+static std::shared_ptr<T> make_in(std::pmr::memory_resource *mem, Args&&... args)
+{
+	return std::allocate_shared<T>(std::pmr::polymorphic_allocator<T>(mem), std::forward<Args>(args)...);
+}
+
+std::shared_ptr<resistance_block> str_to_circuit(const std::string &s)
+{
+	// The arena is released together with the root block, after all nodes
+	struct circuit_storage
+	{
+		std::pmr::monotonic_buffer_resource arena;
+		std::shared_ptr<resistance_block> root;
+	};
+	
+	auto storage = std::make_shared<circuit_storage>();
+	auto mem = &storage->arena;
+	
+	std::vector<std::shared_ptr<resistance_block>> stack;
+	std::map<char, resistor*> leaders;
+	
+	for (size_t pos = 0; pos < s.size(); pos++)
+	{
+		char c = s[pos];
+		switch (c)
+		{
+			case '[':
+				stack.push_back(make_in<parallel>(mem, mem));
+				break;
+			
+			case '(':
+				stack.push_back(make_in<serial>(mem, mem));
+				break;
+			
+			// Capacitors and inductors are upper case only - lower case letters are labels
+			case 'R':
+			case 'r':
+			case 'C':
+			case 'L':
+			{
+				if (stack.empty())
+					throw std::runtime_error{"invalid circ - cannot add resistor, no block"};
+				
+				auto r = make_in<resistor>(mem);
+				r->kind = c == 'C' ? leaf_kind::capacitor : c == 'L' ? leaf_kind::inductor : leaf_kind::resistor;
+				stack.back()->add(r);
+				
+				// Matched group label, such as `Ra`
+				if (pos + 1 < s.size() && std::islower(s[pos + 1]) && s[pos + 1] != 'r')
+				{
+					r->group = s[++pos];
+					auto [it, inserted] = leaders.try_emplace(r->group, r.get());
+					if (!inserted)
+						r->leader = it->second;
+					if (r->leader && r->leader->kind != r->kind)
+						throw std::runtime_error{"invalid circ - matched group of different kinds"};
+				}
+				
+				// Fixed value, such as `R=4.7k`
+				if (pos + 1 < s.size() && s[pos + 1] == '=')
+				{
+					if (r->group)
+						throw std::runtime_error{"invalid circ - matched resistors can't have fixed values"};
+					
+					auto end = s.find_first_not_of("0123456789.", pos + 2);
+					if (end != std::string::npos && std::string{"pnumkMG"}.find(s[end]) != std::string::npos)
+						end++;
+					
+					auto value = s.substr(pos + 2, end == std::string::npos ? std::string::npos : end - pos - 2);
+					if (value.empty())
+						throw std::runtime_error{"invalid circ - missing fixed value"};
+					
+					r->value = from_si_string(value);
+					r->fixed = true;
+					pos += 1 + value.size();
+				}
+				break;
+			}
+			
+			case ']':
+			case ')':
+			{
+				if (stack.empty())
+					throw std::runtime_error{"invalid circ description (stack empty and closing)"};
+				
+				if (stack.size() == 1)
+				{
+					storage->root = stack.back();
+					return {storage, storage->root.get()};
+				}
+				
+				auto top = stack.back();
+				stack.pop_back();
+				
+				if (top->get_children_count() == 0)
+					throw std::runtime_error{"invalid circ - empty block"};
+				
+				stack.back()->add(top);
+				break;
+			}
+			
+			// Separators are only decoration
+			case '+':
+			case '|':
+			case ' ':
+				break;
+			
+			default:
+				throw std::runtime_error{std::string{"invalid circ - unexpected character '"} + c + "'"};
+		}
+	}
+	
+	throw std::runtime_error{"invalid circ - stack not empty"};
+}
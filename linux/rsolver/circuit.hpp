@@ -0,0 +1,196 @@
+#pragma once
+#include <cstdint>
+#include <limits>
+#include <vector>
+#include <memory>
+#include <memory_resource>
+#include <string>
+#include <sstream>
+
+constexpr auto INF = std::numeric_limits<float>::infinity();
+using range = std::pair<float, float>;
+
+struct circuit_program;
+
+//! Leaves are resistors, unless impedance is being solved for
+enum class leaf_kind : std::uint8_t
+{
+	resistor,
+	capacitor,
+	inductor,
+};
+
+std::string to_si_string(float x);
+float from_si_string(const std::string &s);
+
+struct resistance
+{
+	virtual ~resistance() = default;
+	virtual float est_max() const = 0;
+	virtual float est_min() const = 0;
+	virtual void get_resistances(std::vector<float*> &v) = 0;
+	virtual std::string describe() const = 0;
+	virtual void compile(circuit_program &prog) const = 0;
+	virtual std::string structure() const = 0; //!< Equal for interchangeable subtrees, with an 'r' for every slot
+	range est_range() const {return {est_min(), est_max()};}
+	
+	std::vector<float*> get_resistances()
+	{
+		std::vector<float*> v;
+		get_resistances(v);
+		return v;
+	}
+};
+
+/*
+	Leaf of the circuit. Fixed resistors keep the value from the description,
+	and resistors of a matched group share the value of the first one. Only
+	the searched values are returned by get_resistances(). Capacitors and
+	inductors are leaves too - their values are in farads and henries.
+*/
+struct resistor : public resistance
+{
+	virtual ~resistor() = default;
+	float est_max() const override {return (1.f + tol) * get_value();}
+	float est_min() const override {return (1.f - tol) * get_value();}
+	using resistance::get_resistances;
+	void get_resistances(std::vector<float*> &v) override {if (!fixed && !leader) v.push_back(&value);}
+	std::string describe() const override;
+	void compile(circuit_program &prog) const override;
+	std::string structure() const override;
+	float get_value() const {return leader ? leader->value : value;}
+	
+	float value = 100.f;
+	float tol = 0.0f;
+	bool fixed = false;
+	leaf_kind kind = leaf_kind::resistor;
+	char group = 0;                 //!< Matched group label, 0 if none
+	resistor *leader = nullptr;     //!< First resistor of the matched group, unless it's this one
+	mutable std::uint32_t slot = 0; //!< Assigned by compile(), so that the group can share it
+};
+
+struct resistance_block : public resistance
+{
+	resistance_block(std::pmr::memory_resource *mem = std::pmr::get_default_resource()) :
+		resistances(mem)
+	{
+	}
+	
+	virtual ~resistance_block() = default;
+	
+	void add(std::shared_ptr<resistance> ptr) {resistances.push_back(ptr);}
+	int get_children_count() const {return resistances.size();}
+	
+	using resistance::get_resistances;
+	void get_resistances(std::vector<float*> &v) override
+	{
+		for (auto &r : resistances)
+			r->get_resistances(v);
+	}
+	
+	std::pmr::vector<std::shared_ptr<resistance>> resistances;
+
+protected:
+	std::string children_structure() const;
+	void add_symmetries(circuit_program &prog) const;
+};
+
+struct parallel : public resistance_block
+{
+	using resistance_block::resistance_block;
+	virtual ~parallel() = default;
+	
+	float est_max() const override
+	{
+		float ret = 0.f;
+		for (const auto &r : resistances)
+		{
+			auto x = r->est_max();
+			if (x == 0.f) return 0;
+			ret += 1.f / x;
+		}
+		return 1.f / ret;
+	}
+	
+	float est_min() const override
+	{
+		float ret = 0.f;
+		for (const auto &r : resistances)
+		{
+			auto x = r->est_min();
+			if (x == 0.f) return 0;
+			ret += 1.f / x;
+		}
+		return 1.f / ret;
+	}
+	
+	std::string describe() const override
+	{
+		std::stringstream ss;
+		ss << "(";
+		for (auto i = 0u; i < resistances.size(); i++)
+		{
+			ss << resistances[i]->describe();
+			if (i != resistances.size() - 1)
+				ss << " | ";
+		}
+		ss << ")";
+		
+		return ss.str();
+	}
+	
+	void compile(circuit_program &prog) const override;
+	std::string structure() const override {return "[" + children_structure() + "]";}
+};
+
+struct serial : public resistance_block
+{
+	using resistance_block::resistance_block;
+	virtual ~serial() = default;
+	
+	float est_max() const override
+	{
+		float ret = 0;
+		for (const auto &r : resistances)
+			ret += r->est_max();
+		return ret;
+	}
+	
+	float est_min() const override
+	{
+		float ret = 0;
+		for (const auto &r : resistances)
+			ret += r->est_min();
+		return ret;
+	}
+	
+	std::string describe() const override
+	{
+		std::stringstream ss;
+		ss << "(";
+		for (auto i = 0u; i < resistances.size(); i++)
+		{
+			ss << resistances[i]->describe();
+			if (i != resistances.size() - 1)
+				ss << " + ";
+		}
+		ss << ")";
+		
+		return ss.str();
+	}
+	
+	void compile(circuit_program &prog) const override;
+	std::string structure() const override {return "(" + children_structure() + ")";}
+};
+
+std::unique_ptr<resistance> par(std::vector<std::shared_ptr<resistance>> l);
+std::unique_ptr<resistance> ser(std::initializer_list<std::shared_ptr<resistance>> l);
+std::unique_ptr<resistance> res(float r = 100.f, float tol = 0.0f);
+
+/*
+	Parses the circuit description. All nodes are allocated in a single arena,
+	owned by the returned block.
+*/
+std::shared_ptr<resistance_block> str_to_circuit(const std::string &s);
+
+float range_score(const range &target, const range &r);
@@ -0,0 +1,71 @@
+#include "compare.hpp"
+#include "strategy.hpp"
+#include <algorithm>
+#include <iomanip>
+#include <string>
+
+void compare_strategies(const std::vector<float> &avail, search_config cfg, float max_error, std::ostream &out)
+{
+	const std::vector<std::string> circuits{"(r[rr][rr])", "(r[r(rr)][rr]r[rr])", "[(r[rr])(rr)(r[r(rr)])]", "(r[r(r[r(r[rr])])])"};
+	const std::vector<float> targets{1234.5f, 3141.59f, 47700.f, 987654.f};
+	const auto &names = get_strategy_names();
+	
+	out << "Time to get within " << max_error * 100 << "% of the target, in ms (limit " << cfg.time_limit << " s, "
+		<< cfg.threads << " threads)" << std::endl;
+	out << std::setw(28) << std::left << "circuit" << std::setw(10) << "target";
+	for (const auto &name : names)
+		out << std::setw(10) << std::right << name;
+	out << std::endl;
+	
+	std::vector<std::vector<double>> times(names.size());
+	for (const auto &desc : circuits)
+	{
+		auto prog = compile_circuit(*str_to_circuit(desc));
+		for (auto t : targets)
+		{
+			range target{t, t};
+			out << std::setw(28) << std::left << desc << std::setw(10) << to_si_string(t);
+			
+			for (auto s = 0u; s < names.size(); s++)
+			{
+				// Score of a solution with the maximum error at both ends of the range
+				cfg.strategy = names[s];
+				cfg.stop_score = -2 * max_error * t;
+				auto summary = restart_search(prog, avail, target, cfg, [](const search_report&){});
+				
+				out << std::setw(10) << std::right;
+				if (summary.best.score >= cfg.stop_score)
+				{
+					times[s].push_back(summary.time_to_best);
+					out << std::fixed << std::setprecision(2) << summary.time_to_best * 1e3 << std::defaultfloat;
+				}
+				else
+					out << "-";
+				out.flush();
+			}
+			
+			out << std::endl;
+		}
+	}
+	
+	out << std::setw(38) << std::left << "solved";
+	for (auto s = 0u; s < names.size(); s++)
+		out << std::setw(10) << std::right << std::to_string(times[s].size()) + "/" + std::to_string(circuits.size() * targets.size());
+	out << std::endl;
+	
+	out << std::setw(38) << std::left << "median";
+	for (auto s = 0u; s < names.size(); s++)
+	{
+		out << std::setw(10) << std::right;
+		if (times[s].empty())
+		{
+			out << "-";
+			continue;
+		}
+		
+		auto mid = times[s].begin() + times[s].size() / 2;
+		std::nth_element(times[s].begin(), mid, times[s].end());
+		out << std::fixed << std::setprecision(2) << *mid * 1e3 << std::defaultfloat;
+	}
+	out << std::endl;
+}
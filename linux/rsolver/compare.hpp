@@ -0,0 +1,11 @@
+#pragma once
+#include <ostream>
+#include <vector>
+#include "search.hpp"
+
+/*
+	Runs every strategy on a fixed set of circuits and targets, and reports
+	how long it took to get within max_error (relative) of the target. Each
+	run is limited to cfg.time_limit seconds.
+*/
+void compare_strategies(const std::vector<float> &avail, search_config cfg, float max_error, std::ostream &out);
@@ -0,0 +1,495 @@
+#include "daemon.hpp"
+#include "cache.hpp"
+#include "exact.hpp"
+#include "strategy.hpp"
+#include "topology.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+static constexpr size_t max_circuits = 256;       //!< Compiled circuits kept by the daemon
+static constexpr size_t max_worker_circuits = 32; //!< Circuits and strategies kept by each worker
+static constexpr size_t max_line = 64 * 1024;     //!< Longer requests close the connection
+static constexpr size_t max_pending = 1024;       //!< Requests queued per connection before it stops being read
+
+/*
+	Map keeping only the most recently used entries - the least recently used
+	one is evicted once a new one doesn't fit. Capacities are small, so it's
+	found with a linear scan.
+*/
+template <typename T>
+class lru_map
+{
+public:
+	explicit lru_map(size_t capacity) :
+		m_capacity(capacity)
+	{
+	}
+	
+	//! Inserts a default value if the key is missing
+	T &operator[](const std::string &key)
+	{
+		auto it = m_entries.find(key);
+		if (it == m_entries.end())
+		{
+			if (m_entries.size() >= m_capacity)
+				m_entries.erase(std::min_element(m_entries.begin(), m_entries.end(), [](const auto &a, const auto &b){
+					return a.second.used < b.second.used;
+				}));
+			it = m_entries.emplace(key, entry{}).first;
+		}
+		
+		it->second.used = ++m_clock;
+		return it->second.value;
+	}
+
+private:
+	struct entry
+	{
+		T value{};
+		std::uint64_t used = 0;
+	};
+	
+	size_t m_capacity;
+	std::uint64_t m_clock = 0;
+	std::map<std::string, entry> m_entries;
+};
+
+struct compiled_circuit
+{
+	std::string canonical; //!< For cache keys
+	circuit_program prog;
+};
+
+/*
+	Circuits are compiled once, on their first request, and kept until they're
+	evicted by others. Workers share ownership of the circuits they use, since
+	their strategies keep references to the programs.
+*/
+class circuit_registry
+{
+public:
+	std::shared_ptr<const compiled_circuit> get(const std::string &desc)
+	{
+		std::lock_guard lock{m_mutex};
+		auto &c = m_circuits[desc];
+		if (!c)
+		{
+			auto circuit = str_to_circuit(desc);
+			auto prog = compile_circuit(*circuit);
+			if (prog.reactive())
+				throw std::runtime_error{"capacitors and inductors are not supported"};
+			c = std::make_shared<compiled_circuit>(compiled_circuit{canonical_form(*circuit), std::move(prog)});
+		}
+		
+		return c;
+	}
+
+private:
+	std::mutex m_mutex;
+	lru_map<std::shared_ptr<const compiled_circuit>> m_circuits{max_circuits};
+};
+
+//! Circuits for describing solutions, and strategies, reused by a single worker
+struct worker_circuit
+{
+	std::shared_ptr<const compiled_circuit> compiled;
+	std::shared_ptr<resistance_block> circuit;
+	std::unique_ptr<search_strategy> strategy;
+};
+
+using worker_circuits = lru_map<worker_circuit>;
+
+struct daemon_state
+{
+	const std::vector<float> &avail;
+	const daemon_config &cfg;
+	std::string values;
+	circuit_registry circuits;
+};
+
+static std::string describe(worker_circuit &wc, const std::vector<float> &avail, const std::vector<size_t> &indices)
+{
+	auto res = wc.circuit->get_resistances();
+	for (auto i = 0u; i < res.size(); i++)
+		*res[i] = avail[indices[i]];
+	return wc.circuit->describe();
+}
+
+static cached_solution solve(daemon_state &state, worker_circuits &local, const std::string &mode,
+	float t, const std::string &desc)
+{
+	range rt{t, t};
+	const auto &cfg = state.cfg;
+	if (mode == "topologies")
+	{
+		if (!cfg.tsolver)
+			throw std::runtime_error{"the daemon was started without --topologies"};
+		
+		topology_solution best{-1, -INF, {0, 0}, "", false, {}};
+		for (auto i = 0u; i < cfg.tsolver->get_topologies().size() && best.score < 0; i++)
+		{
+			auto sol = cfg.tsolver->solve(i, rt, best.score);
+			if (sol.score > best.score)
+				best = sol;
+		}
+		
+		return {best.rg, best.score, true, best.desc};
+	}
+	
+	auto &wc = local[desc];
+	if (!wc.circuit)
+	{
+		wc.compiled = state.circuits.get(desc);
+		wc.circuit = str_to_circuit(desc);
+	}
+	const auto &compiled = *wc.compiled;
+	
+	if (mode == "exact")
+	{
+		exact_solver solver(compiled.prog, state.avail, rt);
+		solver.solve([](const exact_solver &){});
+		return {solver.best_range, solver.best_score, true, describe(wc, state.avail, solver.best_indices)};
+	}
+	
+	if (mode == "search")
+	{
+		if (!wc.strategy)
+			wc.strategy = make_strategy(cfg.strategy, compiled.prog, state.avail, rt);
+		wc.strategy->reset(rt);
+		
+		// Seeded with the target, so results don't depend on the thread
+		std::uint32_t bits;
+		std::memcpy(&bits, &t, sizeof(bits));
+		std::seed_seq seq{cfg.seed, std::uint64_t(bits)};
+		std::mt19937 rng{seq};
+		
+		solution best;
+		for (int r = 0; r < cfg.restarts && best.score < 0; r++)
+		{
+			const auto &sol = wc.strategy->step(rng);
+			if (sol.score > best.score)
+				best = sol;
+		}
+		
+		return {best.rg, best.score, best.score >= 0, describe(wc, state.avail, best.indices)};
+	}
+	
+	throw std::runtime_error{"unknown request '" + mode + "'"};
+}
+
+static std::string handle_request(daemon_state &state, worker_circuits &local, const std::string &line)
+{
+	std::istringstream ss{line};
+	std::string mode, target, desc;
+	if (!(ss >> mode >> target))
+		throw std::runtime_error{"expected a request and a target"};
+	std::getline(ss >> std::ws, desc);
+	
+	if (mode != "exact" && mode != "search" && mode != "topologies")
+		throw std::runtime_error{"unknown request '" + mode + "'"};
+	
+	float t = from_si_string(target);
+	if (!(t > 0))
+		throw std::runtime_error{"target must be positive"};
+	if (mode != "topologies" && desc.empty())
+		throw std::runtime_error{"missing circuit"};
+	
+	// Proven optimal solutions are good for any search, best known ones only for the heuristic one
+	std::optional<cached_solution> sol;
+	cache_key key;
+	if (state.cfg.cache)
+	{
+		auto circuit = mode == "topologies" ? "topologies:" + std::to_string(state.cfg.topologies) : state.circuits.get(desc)->canonical;
+		key = {circuit, state.values, t};
+		sol = state.cfg.cache->find(key);
+	}
+	
+	if (!sol || !(sol->optimal || mode == "search"))
+	{
+		sol = solve(state, local, mode, t, desc);
+		if (state.cfg.cache)
+			state.cfg.cache->store(key, *sol);
+	}
+	
+	float value = (sol->rg.first + sol->rg.second) / 2;
+	std::stringstream out;
+	out << "ok\t" << value << "\t" << (value - t) / t * 100 << "\t" << sol->desc;
+	return out.str();
+}
+
+static bool write_all(int fd, const std::string &s)
+{
+	for (size_t done = 0; done < s.size();)
+	{
+		// Clients closing the connection early shouldn't kill the daemon with SIGPIPE
+		auto n = send(fd, s.data() + done, s.size() - done, MSG_NOSIGNAL);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return false;
+		done += n;
+	}
+	return true;
+}
+
+/*
+	A client connection. Only the I/O thread reads from it, and only one of
+	its requests is handled at a time, so responses are sent in order. The
+	socket is closed once nothing refers to the connection any more.
+*/
+struct connection
+{
+	explicit connection(int fd) :
+		fd(fd)
+	{
+	}
+	
+	~connection()
+	{
+		close(fd);
+	}
+	
+	int fd;
+	std::string input;              //!< Received, but not a complete line yet
+	std::mutex mutex;               //!< Guards everything below
+	std::deque<std::string> lines;  //!< Requests waiting to be handled
+	bool busy = false;              //!< Queued for, or being handled by, a worker
+	bool paused = false;            //!< Not read while too many requests are waiting
+	bool closed = false;
+};
+
+/*
+	Workers take connections with a pending request from the queue, handle
+	a single request and put the connection back at the end of the queue if
+	it has more - so long-lived and busy clients share the pool fairly, and
+	idle ones don't occupy any thread.
+*/
+class request_queue
+{
+public:
+	void push(std::shared_ptr<connection> c)
+	{
+		std::lock_guard lock{m_mutex};
+		m_queue.push_back(std::move(c));
+		m_cv.notify_one();
+	}
+	
+	std::shared_ptr<connection> pop()
+	{
+		std::unique_lock lock{m_mutex};
+		m_cv.wait(lock, [&]{return !m_queue.empty();});
+		auto c = std::move(m_queue.front());
+		m_queue.pop_front();
+		return c;
+	}
+
+private:
+	std::mutex m_mutex;
+	std::condition_variable m_cv;
+	std::deque<std::shared_ptr<connection>> m_queue;
+};
+
+static void serve_request(daemon_state &state, worker_circuits &local, request_queue &queue, int epoll_fd,
+	const std::shared_ptr<connection> &c)
+{
+	std::string line;
+	{
+		std::lock_guard lock{c->mutex};
+		line = std::move(c->lines.front());
+		c->lines.pop_front();
+	}
+	
+	std::string response;
+	try
+	{
+		response = handle_request(state, local, line);
+	}
+	catch (const std::exception &e)
+	{
+		response = "error\t" + std::string{e.what()};
+	}
+	response += '\n';
+	bool sent = write_all(c->fd, response);
+	
+	std::lock_guard lock{c->mutex};
+	if (!sent)
+	{
+		// The I/O thread sees the hangup and forgets the connection
+		c->lines.clear();
+		shutdown(c->fd, SHUT_RDWR);
+	}
+	
+	if (c->paused && c->lines.size() < max_pending / 2)
+	{
+		epoll_event ev{};
+		ev.events = EPOLLIN;
+		ev.data.fd = c->fd;
+		if (!c->closed && epoll_ctl(epoll_fd, EPOLL_CTL_MOD, c->fd, &ev) == 0)
+			c->paused = false;
+	}
+	
+	c->busy = !c->lines.empty();
+	if (c->busy)
+		queue.push(c);
+}
+
+// Reads everything available, queueing complete lines - returns false once the connection is done
+static bool read_requests(connection &c, int epoll_fd, request_queue &queue, const std::shared_ptr<connection> &ptr)
+{
+	char chunk[4096];
+	bool open = true;
+	while (true)
+	{
+		auto n = recv(c.fd, chunk, sizeof(chunk), MSG_DONTWAIT);
+		if (n > 0)
+		{
+			c.input.append(chunk, n);
+			continue;
+		}
+		if (n < 0 && errno == EINTR)
+			continue;
+		open = n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+		break;
+	}
+	
+	std::vector<std::string> lines;
+	size_t start = 0;
+	for (size_t end; (end = c.input.find('\n', start)) != std::string::npos; start = end + 1)
+	{
+		auto line = c.input.substr(start, end - start);
+		if (line.find_first_not_of(" \t\r") != std::string::npos)
+			lines.push_back(std::move(line));
+	}
+	c.input.erase(0, start);
+	if (c.input.size() > max_line)
+		open = false;
+	
+	std::lock_guard lock{c.mutex};
+	for (auto &line : lines)
+		c.lines.push_back(std::move(line));
+	
+	if (open && c.lines.size() >= max_pending)
+	{
+		epoll_event ev{};
+		ev.data.fd = c.fd;
+		epoll_ctl(epoll_fd, EPOLL_CTL_MOD, c.fd, &ev);
+		c.paused = true;
+	}
+	
+	if (!open)
+	{
+		// Requests already received are still answered
+		epoll_ctl(epoll_fd, EPOLL_CTL_DEL, c.fd, nullptr);
+		c.closed = true;
+	}
+	
+	if (!c.busy && !c.lines.empty())
+	{
+		c.busy = true;
+		queue.push(ptr);
+	}
+	
+	return open;
+}
+
+void run_daemon(const std::string &socket_path, const std::vector<float> &avail, const daemon_config &cfg)
+{
+	sockaddr_un addr{};
+	addr.sun_family = AF_UNIX;
+	if (socket_path.size() >= sizeof(addr.sun_path))
+		throw std::runtime_error{"socket path too long"};
+	std::strcpy(addr.sun_path, socket_path.c_str());
+	
+	int listener = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0);
+	if (listener < 0)
+		throw std::runtime_error{"could not create socket"};
+	
+	// A socket left by a previous instance would make bind() fail
+	unlink(socket_path.c_str());
+	if (bind(listener, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) || listen(listener, 128))
+	{
+		close(listener);
+		throw std::runtime_error{"could not listen on " + socket_path};
+	}
+	
+	int epoll_fd = epoll_create1(0);
+	epoll_event listen_ev{};
+	listen_ev.events = EPOLLIN;
+	listen_ev.data.fd = listener;
+	if (epoll_fd < 0 || epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listener, &listen_ev))
+		throw std::runtime_error{"could not watch " + socket_path};
+	
+	daemon_state state{avail, cfg, values_id(avail), {}};
+	request_queue queue;
+	std::vector<std::thread> workers;
+	for (auto i = 0u; i < std::max(1u, cfg.threads); i++)
+		workers.emplace_back([&]{
+			worker_circuits local{max_worker_circuits};
+			while (true)
+				serve_request(state, local, queue, epoll_fd, queue.pop());
+		});
+	
+	// The I/O thread accepts connections and reads requests, the workers only handle them
+	std::map<int, std::shared_ptr<connection>> connections;
+	epoll_event events[64];
+	while (true)
+	{
+		int n = epoll_wait(epoll_fd, events, 64, -1);
+		for (int i = 0; i < n; i++)
+		{
+			int fd = events[i].data.fd;
+			if (fd != listener)
+			{
+				auto it = connections.find(fd);
+				if (it != connections.end() && !read_requests(*it->second, epoll_fd, queue, it->second))
+					connections.erase(it);
+				continue;
+			}
+			
+			while (true)
+			{
+				int client = accept(listener, nullptr, nullptr);
+				if (client >= 0)
+				{
+					epoll_event ev{};
+					ev.events = EPOLLIN;
+					ev.data.fd = client;
+					if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, client, &ev))
+						close(client);
+					else
+						connections[client] = std::make_shared<connection>(client);
+					continue;
+				}
+				
+				if (errno == EAGAIN || errno == EWOULDBLOCK)
+					break;
+				if (errno == EINTR || errno == ECONNABORTED)
+					continue;
+				
+				// Out of descriptors or memory - wait for some connections to close
+				if (errno == EMFILE || errno == ENFILE || errno == ENOBUFS || errno == ENOMEM)
+				{
+					std::cerr << "accept failed: " << std::strerror(errno) << ", retrying" << std::endl;
+					std::this_thread::sleep_for(std::chrono::milliseconds(100));
+					break;
+				}
+				
+				throw std::runtime_error{"accept failed: " + std::string{std::strerror(errno)}};
+			}
+		}
+	}
+}
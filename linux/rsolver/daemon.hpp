@@ -0,0 +1,37 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class topology_solver;
+class solution_cache;
+
+struct daemon_config
+{
+	unsigned threads = 1;
+	int restarts = 100;               //!< Per target, for the heuristic search
+	std::uint64_t seed = 0;
+	std::string strategy = "descent";
+	topology_solver *tsolver = nullptr; //!< Prepared, for topology requests
+	int topologies = 0;                 //!< Maximum number of resistors of the topology solver
+	solution_cache *cache = nullptr;
+};
+
+/*
+	Serves requests on a Unix domain socket, until the process is killed. The
+	available values, topology tables and recently used compiled circuits stay
+	resident, so a request costs just the search itself. A single thread
+	watches the connections, and requests are handled one at a time by a pool
+	of cfg.threads threads, so idle connections don't hold any. Each
+	connection can send any number of requests, one per line, and gets the
+	responses in the same order:
+		
+		exact TARGET CIRCUIT       branch-and-bound search
+		search TARGET CIRCUIT      random-restart search (cfg.restarts restarts)
+		topologies TARGET          best series-parallel network (needs cfg.tsolver)
+	
+	Each request gets a single line in response - either "ok", followed by
+	the resistance, the relative error (in percent) and the description, or
+	"error" followed by a message, all separated by tabs.
+*/
+void run_daemon(const std::string &socket_path, const std::vector<float> &avail, const daemon_config &cfg);
@@ -0,0 +1,221 @@
+#include "divider.hpp"
+#include "strategy.hpp"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <sstream>
+#include <stdexcept>
+
+// Ratios are rounded, so errors below this are counted as exact matches
+static constexpr float exact_error = 1e-6f;
+
+divider_chain::divider_chain(std::vector<float> ratios, size_t segment_size) :
+	ratios(std::move(ratios)),
+	segment_size(segment_size)
+{
+	if (this->ratios.empty())
+		throw std::runtime_error{"a divider needs at least one tap"};
+	if (!segment_size)
+		throw std::runtime_error{"segments need at least one resistor"};
+	
+	std::sort(this->ratios.begin(), this->ratios.end());
+	for (auto i = 0u; i < this->ratios.size(); i++)
+	{
+		if (!(this->ratios[i] > 0 && this->ratios[i] < 1))
+			throw std::runtime_error{"tap ratios must be between 0 and 1"};
+		if (i && this->ratios[i] == this->ratios[i - 1])
+			throw std::runtime_error{"tap ratios must be distinct"};
+	}
+}
+
+void divider_chain::taps(const float *values, float *out) const
+{
+	double sum = 0;
+	for (auto i = 0u; i < size(); i++)
+	{
+		sum += values[i];
+		if ((i + 1) % segment_size == 0 && i + 1 < size())
+			out[i / segment_size] = sum;
+	}
+	
+	for (auto i = 0u; i < ratios.size(); i++)
+		out[i] = sum > 0 ? out[i] / sum : 0;
+}
+
+std::string divider_chain::describe(const float *values) const
+{
+	// From the top of the chain down, with taps labelled by their targets
+	std::stringstream ss;
+	ss << "top";
+	for (auto s = ratios.size() + 1; s-- > 0;)
+	{
+		ss << " - ";
+		bool first = true;
+		for (auto i = s * segment_size; i < (s + 1) * segment_size; i++)
+			if (values[i] > 0)
+			{
+				ss << (first ? "" : " + ") << to_si_string(values[i]);
+				first = false;
+			}
+		if (first)
+			ss << "0";
+		
+		if (s)
+			ss << " - [" << ratios[s - 1] << "]";
+	}
+	
+	ss << " - bottom";
+	return ss.str();
+}
+
+std::vector<float> parse_ratios(const std::string &s)
+{
+	std::vector<float> ratios;
+	std::stringstream ss{s};
+	for (std::string item; std::getline(ss, item, ',');)
+		ratios.push_back(std::stof(item));
+	return ratios;
+}
+
+float divider_score(const divider_chain &chain, const float *taps)
+{
+	float worst = 0;
+	for (auto i = 0u; i < chain.ratios.size(); i++)
+		worst = std::max(worst, std::abs(taps[i] - chain.ratios[i]) / chain.ratios[i]);
+	return worst < exact_error ? 0 : -worst;
+}
+
+divider_evaluator::divider_evaluator(const divider_chain &chain) :
+	m_chain(chain),
+	m_values(chain.size()),
+	m_sums(chain.ratios.size()),
+	m_total(0),
+	m_inv_ratios(chain.ratios.size())
+{
+	for (auto i = 0u; i < chain.ratios.size(); i++)
+		m_inv_ratios[i] = 1 / chain.ratios[i];
+}
+
+void divider_evaluator::set(const float *values)
+{
+	std::copy_n(values, m_values.size(), m_values.begin());
+	
+	// Sums are kept in double precision, so commits can update them in place
+	m_total = 0;
+	for (auto i = 0u; i < m_values.size(); i++)
+	{
+		m_total += m_values[i];
+		if ((i + 1) % m_chain.segment_size == 0 && i + 1 < m_values.size())
+			m_sums[i / m_chain.segment_size] = m_total;
+	}
+}
+
+float divider_evaluator::probe(size_t slot, float value) const
+{
+	double delta = value - m_values[slot];
+	double total = m_total + delta;
+	if (!(total > 0))
+		return -FLT_MAX;
+	
+	// Taps below the segment of the slot keep their sums
+	float inv_total = 1 / total;
+	auto first = slot / m_chain.segment_size;
+	float worst = 0;
+	for (auto i = 0u; i < first; i++)
+		worst = std::max(worst, std::abs(float(m_sums[i]) * inv_total * m_inv_ratios[i] - 1));
+	for (auto i = first; i < m_sums.size(); i++)
+		worst = std::max(worst, std::abs(float(m_sums[i] + delta) * inv_total * m_inv_ratios[i] - 1));
+	return worst < exact_error ? 0 : -worst;
+}
+
+void divider_evaluator::commit(size_t slot, float value)
+{
+	double delta = value - m_values[slot];
+	m_values[slot] = value;
+	m_total += delta;
+	for (auto i = slot / m_chain.segment_size; i < m_sums.size(); i++)
+		m_sums[i] += delta;
+}
+
+class divider_strategy : public search_strategy
+{
+public:
+	divider_strategy(const divider_chain &chain, const std::vector<float> &avail) :
+		m_chain(chain),
+		m_avail(avail),
+		m_eval(chain),
+		m_values(chain.size())
+	{
+		m_sol.indices.resize(chain.size());
+	}
+	
+	// Ratios are the target, so there's nothing to reset
+	void reset(range) override
+	{
+	}
+	
+	const solution &step(std::mt19937 &rng) override
+	{
+		std::uniform_int_distribution<size_t> dist(0, m_avail.size() - 1);
+		for (auto i = 0u; i < m_values.size(); i++)
+		{
+			m_sol.indices[i] = dist(rng);
+			m_values[i] = m_avail[m_sol.indices[i]];
+		}
+		
+		m_eval.set(m_values.data());
+		m_sol.evals = 1;
+		m_sol.moves = 0;
+		m_sol.score = m_eval.score();
+		for (bool improved = true; improved;)
+		{
+			improved = false;
+			for (auto i = 0u; i < m_values.size(); i++)
+			{
+				size_t best = m_sol.indices[i];
+				float best_score = m_sol.score;
+				for (auto v = 0u; v < m_avail.size(); v++)
+				{
+					float s = m_eval.probe(i, m_avail[v]);
+					if (s > best_score)
+					{
+						best = v;
+						best_score = s;
+					}
+				}
+				
+				m_sol.evals += m_avail.size();
+				if (best != m_sol.indices[i])
+				{
+					m_sol.indices[i] = best;
+					m_values[i] = m_avail[best];
+					m_eval.commit(i, m_values[i]);
+					m_sol.score = m_eval.score();
+					m_sol.moves++;
+					improved = true;
+				}
+			}
+		}
+		
+		for (auto s = 0u; s < m_chain.ratios.size() + 1; s++)
+		{
+			auto begin = m_sol.indices.begin() + s * m_chain.segment_size;
+			std::sort(begin, begin + m_chain.segment_size);
+		}
+		
+		m_sol.rg = {float(m_eval.total()), float(m_eval.total())};
+		return m_sol;
+	}
+
+private:
+	const divider_chain &m_chain;
+	const std::vector<float> &m_avail;
+	divider_evaluator m_eval;
+	std::vector<float> m_values;
+	solution m_sol;
+};
+
+std::unique_ptr<search_strategy> make_divider_strategy(const divider_chain &chain, const std::vector<float> &avail)
+{
+	return std::make_unique<divider_strategy>(chain, avail);
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <vector>
+
+class search_strategy;
+
+/*
+	String of resistors with several taps, such as a comparator ladder. The
+	chain is split into segments of segment_size resistors in series, with a
+	tap between every two neighbouring segments. Resistors are numbered from
+	the grounded bottom end, and so are the taps - the ratio of tap i is the
+	resistance of segments 0..i over the resistance of the whole chain.
+*/
+struct divider_chain
+{
+	divider_chain(std::vector<float> ratios, size_t segment_size);
+	size_t size() const {return (ratios.size() + 1) * segment_size;}
+	
+	//! Ratios of all taps, in a single prefix-sum pass
+	void taps(const float *values, float *out) const;
+	std::string describe(const float *values) const;
+	
+	std::vector<float> ratios; //!< Targets of the taps, ascending
+	size_t segment_size;
+};
+
+//! Parses a comma-separated list of tap ratios
+std::vector<float> parse_ratios(const std::string &s);
+
+//! Negated worst relative error over all taps
+float divider_score(const divider_chain &chain, const float *taps);
+
+/*
+	Evaluates changes of a single resistor of a chain. The sums of the chain
+	up to every tap are kept, and a change only shifts the sums of the taps
+	above it and the total by the same amount - so a candidate costs a single
+	pass over the taps, regardless of the length of the chain.
+*/
+class divider_evaluator
+{
+public:
+	explicit divider_evaluator(const divider_chain &chain);
+	
+	void set(const float *values);
+	
+	//! Score with a single value changed
+	float probe(size_t slot, float value) const;
+	void commit(size_t slot, float value);
+	float score() const {return probe(0, m_values[0]);}
+	float total() const {return m_total;}
+
+private:
+	const divider_chain &m_chain;
+	std::vector<float> m_values;
+	std::vector<double> m_sums; //!< Of segments up to each tap
+	double m_total;
+	std::vector<float> m_inv_ratios;
+};
+
+/*
+	Random-restart coordinate descent, minimizing the worst tap error. The
+	error isn't monotone in any single resistor, so every value is scanned.
+	Solutions are canonical - resistors within a segment are sorted.
+*/
+std::unique_ptr<search_strategy> make_divider_strategy(const divider_chain &chain, const std::vector<float> &avail);
@@ -0,0 +1,179 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <algorithm>
+#include "circuit.hpp"
+#include "program.hpp"
+#include "batch.hpp"
+
+/*
+	Exhaustive branch-and-bound search. Resistors are assigned one by one, in the
+	order returned by get_resistances(). For a partial assignment, the reachable
+	range is bounded by evaluating the circuit with all unassigned resistors set to
+	the smallest and to the largest available value (resistance is monotone in every
+	resistor). Subtrees which cannot beat the incumbent score are pruned. Values of
+	identical siblings are only assigned in lexicographic order, so that permutations
+	of the same solution aren't searched again.
+*/
+struct exact_solver
+{
+	exact_solver(resistance &circuit, const std::vector<float> &avail, range target) :
+		exact_solver(compile_circuit(circuit), avail, target)
+	{
+		this->circuit = &circuit;
+	}
+	
+	// Leaves sharing a slot get the same value. Solutions can't be described.
+	exact_solver(circuit_program prog, const std::vector<float> &avail, range target) :
+		prog(std::move(prog)),
+		avail(avail),
+		target(target),
+		indices(this->prog.size()),
+		values(this->prog.size()),
+		kernel(get_batch_kernel(this->prog)),
+		batch_values(this->prog.size() * batch_lanes),
+		children(this->prog.size()),
+		orders(this->prog.size())
+	{
+		for (auto &c : children)
+			c.reserve(avail.size());
+		
+		for (const auto &sym : this->prog.symmetries)
+			for (auto j = 0u; j < sym.length; j++)
+				orders[sym.b + j].push_back({sym.a, sym.b});
+	}
+	
+	template <typename F>
+	void solve(F &&on_improvement)
+	{
+		search(0, on_improvement);
+	}
+	
+	/*
+		Fills the batch with consecutive candidate values of the resistor at the
+		depth in the lanes, and `rest` for the resistors after it. The assigned
+		resistors are already there. If `ordered`, the first resistor of a sibling
+		is never smaller than the first resistor of the identical sibling before it.
+	*/
+	void fill_batch(size_t depth, size_t first, float rest, bool ordered)
+	{
+		for (auto l = 0u; l < batch_lanes; l++)
+			batch_values[depth * batch_lanes + l] = avail[std::min(first + l, avail.size() - 1)];
+		
+		for (auto s = depth + 1; s < values.size(); s++)
+		{
+			float *v = &batch_values[s * batch_lanes];
+			std::fill_n(v, batch_lanes, rest);
+			if (ordered)
+				for (auto [a, b] : orders[s])
+					if (b == s)
+						for (auto l = 0u; l < batch_lanes; l++)
+							v[l] = std::max(v[l], batch_values[a * batch_lanes + l]);
+		}
+	}
+	
+	template <typename F>
+	void search(size_t depth, F &on_improvement)
+	{
+		nodes++;
+		
+		if (depth == values.size())
+		{
+			range rg = prog.eval(values.data());
+			float score = range_score(target, rg);
+			if (score > best_score)
+			{
+				best_score = score;
+				best_range = rg;
+				best_indices = indices;
+				on_improvement(*this);
+			}
+			return;
+		}
+		
+		// Visit the most promising values first, so the incumbent improves quickly.
+		// Ties in the bound are broken by the score obtained with the remaining
+		// resistors set to the median available value. Candidates are evaluated
+		// with the batch kernels.
+		auto &children = this->children[depth];
+		children.clear();
+		if (depth > 0)
+			std::fill_n(&batch_values[(depth - 1) * batch_lanes], batch_lanes, values[depth - 1]);
+		auto dist = [](float t, float a, float b){return t < a ? a - t : (t > b ? t - b : 0.f);};
+		alignas(64) float lo[3][batch_lanes];
+		alignas(64) float hi[3][batch_lanes];
+		for (auto first = min_index(depth); first < avail.size(); first += batch_lanes)
+		{
+			// The range is bounded with the remaining resistors set to the smallest
+			// and to the largest available value
+			fill_batch(depth, first, avail.front(), true);
+			kernel.eval(prog, batch_values.data(), lo[0], hi[0]);
+			fill_batch(depth, first, avail.back(), false);
+			kernel.eval(prog, batch_values.data(), lo[1], hi[1]);
+			fill_batch(depth, first, avail[avail.size() / 2], false);
+			kernel.eval(prog, batch_values.data(), lo[2], hi[2]);
+			
+			for (auto l = 0u; l < batch_lanes && first + l < avail.size(); l++)
+			{
+				// Pruned candidates don't need to be sorted
+				float b = -dist(target.first, lo[0][l], lo[1][l]) - dist(target.second, hi[0][l], hi[1][l]);
+				if (b > best_score)
+					children.push_back({b, range_score(target, {lo[2][l], hi[2][l]}), first + l});
+			}
+		}
+		
+		std::sort(children.begin(), children.end(), [](const auto &lhs, const auto &rhs){
+			return lhs > rhs;
+		});
+		
+		for (const auto &[b, guess, v] : children)
+		{
+			if (b <= best_score)
+				break;
+			
+			indices[depth] = v;
+			values[depth] = avail[v];
+			search(depth + 1, on_improvement);
+		}
+	}
+	
+	// Smallest value index allowed by the symmetries, with the previous resistors assigned
+	size_t min_index(size_t depth) const
+	{
+		size_t min = 0;
+		for (auto [a, b] : orders[depth])
+		{
+			auto j = depth - b;
+			if (std::equal(&indices[a], &indices[a] + j, &indices[b]))
+				min = std::max(min, indices[a + j]);
+		}
+		return min;
+	}
+	
+	resistance *circuit = nullptr;
+	circuit_program prog;
+	const std::vector<float> &avail;
+	range target;
+	std::vector<size_t> indices;
+	std::vector<float> values;
+	batch_kernel kernel;
+	std::vector<float> batch_values; //!< Candidates at the current depth, batch_lanes values per slot
+	
+	// Describes the best solution - only needed when it's reported
+	std::string best_desc() const
+	{
+		auto res = circuit->get_resistances();
+		for (auto i = 0u; i < res.size(); i++)
+			*res[i] = avail[best_indices[i]];
+		return circuit->describe();
+	}
+	
+	std::vector<std::vector<std::tuple<float, float, size_t>>> children; //!< Candidates at each depth
+	std::vector<std::vector<std::pair<size_t, size_t>>> orders; //!< Symmetries (first leaves of both siblings) constraining each resistor
+	std::vector<size_t> best_indices;
+	float best_score = -INF;
+	range best_range;
+	size_t nodes = 0;
+};
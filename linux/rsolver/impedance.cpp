@@ -0,0 +1,241 @@
+#include "impedance.hpp"
+#include "batch.hpp"
+#include "strategy.hpp"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <stdexcept>
+
+impedance_target parse_impedance_target(const std::string &s)
+{
+	auto first = s.find(':');
+	if (first == std::string::npos)
+		throw std::runtime_error{"impedance target should be given as FREQUENCY:MAGNITUDE[:PHASE]"};
+	
+	auto second = s.find(':', first + 1);
+	impedance_target t;
+	t.frequency = from_si_string(s.substr(0, first));
+	t.magnitude = from_si_string(s.substr(first + 1, second == std::string::npos ? std::string::npos : second - first - 1));
+	if (second != std::string::npos)
+	{
+		t.phase = from_si_string(s.substr(second + 1));
+		t.has_phase = true;
+	}
+	
+	if (t.frequency <= 0 || t.magnitude <= 0)
+		throw std::runtime_error{"impedance target frequency and magnitude must be positive"};
+	
+	return t;
+}
+
+impedance_evaluator::impedance_evaluator(const circuit_program &prog, const std::vector<float> &frequencies) :
+	m_prog(prog),
+	m_size(frequencies.size()),
+	m_stack(2 * batch_lanes * (prog.stack_depth + 1))
+{
+	for (auto f : frequencies)
+		m_omegas.push_back(2 * M_PI * f);
+	
+	// Padding lanes are evaluated too, so they shouldn't be at DC
+	while (m_omegas.size() % batch_lanes)
+		m_omegas.push_back(1);
+}
+
+void impedance_evaluator::eval(const float *values, float *re, float *im)
+{
+	constexpr size_t W = batch_lanes;
+	for (size_t block = 0; block < m_omegas.size(); block += W)
+	{
+		const float *w = &m_omegas[block];
+		float *stack = m_stack.data() + 2 * W; // With a spare entry below, so that a is always in bounds
+		const std::uint32_t *slot = m_prog.slots.data();
+		size_t constant = 0;
+		size_t sp = 0;
+		
+		for (auto op : m_prog.ops)
+		{
+			// Binary operations pop b, and replace a with the result
+			if (op == opcode::serial || op == opcode::parallel)
+				sp--;
+			float *br = stack + 2 * W * sp, *bi = br + W;
+			float *ar = br - 2 * W, *ai = ar + W;
+			
+			switch (op)
+			{
+				case opcode::leaf:
+				case opcode::constant:
+				{
+					float v;
+					leaf_kind kind;
+					if (op == opcode::leaf)
+					{
+						v = values[*slot];
+						kind = m_prog.kinds[*slot++];
+					}
+					else
+					{
+						const auto &rg = m_prog.constants[constant];
+						v = (rg.first + rg.second) / 2;
+						kind = m_prog.constant_kinds[constant++];
+					}
+					
+					for (size_t l = 0; l < W; l++)
+					{
+						br[l] = kind == leaf_kind::resistor ? v : 0.f;
+						bi[l] = kind == leaf_kind::capacitor ? -1.f / std::max(w[l] * v, FLT_MIN)
+							: kind == leaf_kind::inductor ? w[l] * v : 0.f;
+					}
+					
+					sp++;
+					break;
+				}
+				
+				case opcode::serial:
+					for (size_t l = 0; l < W; l++)
+					{
+						ar[l] += br[l];
+						ai[l] += bi[l];
+					}
+					break;
+				
+				// a * b / (a + b), with the division by the conjugate
+				case opcode::parallel:
+					for (size_t l = 0; l < W; l++)
+					{
+						float nr = ar[l] * br[l] - ai[l] * bi[l];
+						float ni = ar[l] * bi[l] + ai[l] * br[l];
+						float dr = ar[l] + br[l];
+						float di = ai[l] + bi[l];
+						float d = std::max(dr * dr + di * di, FLT_MIN);
+						ar[l] = (nr * dr + ni * di) / d;
+						ai[l] = (ni * dr - nr * di) / d;
+					}
+					break;
+			}
+		}
+		
+		auto n = std::min(W, m_size - block);
+		std::copy_n(stack, n, re + block);
+		std::copy_n(stack + W, n, im + block);
+	}
+}
+
+float impedance_score(const std::vector<impedance_target> &targets, const float *re, const float *im)
+{
+	float worst = 0;
+	for (auto i = 0u; i < targets.size(); i++)
+	{
+		const auto &t = targets[i];
+		float error;
+		if (t.has_phase)
+		{
+			float phi = t.phase * float(M_PI / 180);
+			error = std::hypot(re[i] - t.magnitude * std::cos(phi), im[i] - t.magnitude * std::sin(phi)) / t.magnitude;
+		}
+		else
+			error = std::abs(std::hypot(re[i], im[i]) - t.magnitude) / t.magnitude;
+		
+		worst = std::max(worst, error);
+	}
+	
+	return -worst;
+}
+
+class impedance_strategy : public search_strategy
+{
+public:
+	impedance_strategy(const circuit_program &prog, const std::vector<float> &avail,
+		const std::vector<std::pair<size_t, size_t>> &kind_ranges, const std::vector<impedance_target> &targets) :
+		m_prog(prog),
+		m_avail(avail),
+		m_targets(targets),
+		m_eval(prog, frequencies(targets)),
+		m_values(prog.size()),
+		m_re(targets.size()),
+		m_im(targets.size())
+	{
+		for (auto kind : prog.kinds)
+			m_ranges.push_back(kind_ranges.at(static_cast<int>(kind)));
+		m_sol.indices.resize(prog.size());
+	}
+	
+	// The targets are fixed
+	void reset(range) override
+	{
+	}
+	
+	const solution &step(std::mt19937 &rng) override
+	{
+		for (auto i = 0u; i < m_values.size(); i++)
+		{
+			auto [lo, hi] = m_ranges[i];
+			m_sol.indices[i] = std::uniform_int_distribution<size_t>(lo, hi - 1)(rng);
+			m_values[i] = m_avail[m_sol.indices[i]];
+		}
+		
+		m_sol.evals = 0;
+		m_sol.moves = 0;
+		m_sol.score = score();
+		for (bool improved = true; improved;)
+		{
+			improved = false;
+			for (auto i = 0u; i < m_values.size(); i++)
+			{
+				auto [lo, hi] = m_ranges[i];
+				size_t best = m_sol.indices[i];
+				for (auto v = lo; v < hi; v++)
+				{
+					m_values[i] = m_avail[v];
+					float s = score();
+					if (s > m_sol.score)
+					{
+						best = v;
+						m_sol.score = s;
+						improved = true;
+					}
+				}
+				
+				m_sol.moves += best != m_sol.indices[i];
+				m_sol.indices[i] = best;
+				m_values[i] = m_avail[best];
+			}
+		}
+		
+		canonicalize(m_prog, m_sol.indices.data());
+		m_eval.eval(m_values.data(), m_re.data(), m_im.data());
+		float magnitude = std::hypot(m_re[0], m_im[0]);
+		m_sol.rg = {magnitude, magnitude};
+		return m_sol;
+	}
+
+private:
+	static std::vector<float> frequencies(const std::vector<impedance_target> &targets)
+	{
+		std::vector<float> f;
+		for (const auto &t : targets)
+			f.push_back(t.frequency);
+		return f;
+	}
+	
+	float score()
+	{
+		m_sol.evals++;
+		m_eval.eval(m_values.data(), m_re.data(), m_im.data());
+		return impedance_score(m_targets, m_re.data(), m_im.data());
+	}
+	
+	const circuit_program &m_prog;
+	const std::vector<float> &m_avail;
+	const std::vector<impedance_target> &m_targets;
+	std::vector<std::pair<size_t, size_t>> m_ranges; //!< Values available for each slot
+	impedance_evaluator m_eval;
+	std::vector<float> m_values;
+	std::vector<float> m_re, m_im;
+	solution m_sol;
+};
+
+std::unique_ptr<search_strategy> make_impedance_strategy(const circuit_program &prog, const std::vector<float> &avail,
+	const std::vector<std::pair<size_t, size_t>> &kind_ranges, const std::vector<impedance_target> &targets)
+{
+	return std::make_unique<impedance_strategy>(prog, avail, kind_ranges, targets);
+}
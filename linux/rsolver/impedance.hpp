@@ -0,0 +1,60 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include "program.hpp"
+
+class search_strategy;
+
+/*
+	Impedance to be matched at a single frequency. Without a phase, only the
+	magnitude is matched.
+*/
+struct impedance_target
+{
+	float frequency;
+	float magnitude;
+	float phase = 0; //!< In degrees
+	bool has_phase = false;
+};
+
+//! Parses FREQUENCY:MAGNITUDE[:PHASE], with SI suffixes
+impedance_target parse_impedance_target(const std::string &s);
+
+/*
+	Complex impedance of a circuit at many frequencies. The program is
+	interpreted once per block of batch_lanes frequencies, and every operation
+	is applied to the whole block - real and imaginary parts are kept in
+	separate arrays, so the lane loops are vectorized just like the batch
+	kernels, and a whole sweep costs about as much as a single frequency.
+	Values are nominal - tolerances are ignored.
+*/
+class impedance_evaluator
+{
+public:
+	impedance_evaluator(const circuit_program &prog, const std::vector<float> &frequencies);
+	
+	//! Writes real and imaginary parts of the impedance at every frequency
+	void eval(const float *values, float *re, float *im);
+	
+	size_t size() const {return m_size;}
+
+private:
+	const circuit_program &m_prog;
+	size_t m_size;
+	std::vector<float> m_omegas; //!< Padded to whole blocks
+	std::vector<float> m_stack;  //!< Real parts of an entry, followed by the imaginary ones
+};
+
+//! Negated worst relative error over all targets
+float impedance_score(const std::vector<impedance_target> &targets, const float *re, const float *im);
+
+/*
+	Random-restart coordinate descent for circuits with capacitors and
+	inductors. Values of each kind are taken from their own range of avail.
+	Impedance isn't monotone in the values, so every coordinate is scanned
+	in full, with one evaluation of the whole sweep per candidate.
+*/
+std::unique_ptr<search_strategy> make_impedance_strategy(const circuit_program &prog, const std::vector<float> &avail,
+	const std::vector<std::pair<size_t, size_t>> &kind_ranges, const std::vector<impedance_target> &targets);
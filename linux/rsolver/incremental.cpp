@@ -0,0 +1,192 @@
+#include "incremental.hpp"
+#include <algorithm>
+#include <cfloat>
+
+incremental_circuit::incremental_circuit(const circuit_program &prog) :
+	m_ops(prog.ops),
+	m_parent(prog.ops.size(), -1),
+	m_left(prog.ops.size(), -1),
+	m_right(prog.ops.size(), -1),
+	m_leaf_node(prog.size(), -1),
+	m_node_slot(prog.ops.size(), -1),
+	m_shared(prog.size()),
+	m_tols(prog.tols),
+	m_cache(prog.ops.size()),
+	m_scratch(prog.ops.size())
+{
+	std::vector<std::int32_t> stack;
+	size_t leaf = 0, constant = 0;
+	for (auto i = 0u; i < m_ops.size(); i++)
+	{
+		if (m_ops[i] == opcode::leaf)
+		{
+			auto slot = prog.slots[leaf++];
+			m_node_slot[i] = slot;
+			if (m_leaf_node[slot] < 0)
+				m_leaf_node[slot] = i;
+			else
+				m_shared[slot] = true;
+		}
+		else if (m_ops[i] == opcode::constant)
+		{
+			m_cache[i] = prog.constants[constant++];
+		}
+		else
+		{
+			m_right[i] = stack.back();
+			stack.pop_back();
+			m_left[i] = stack.back();
+			stack.pop_back();
+			m_parent[m_left[i]] = m_parent[m_right[i]] = i;
+		}
+		
+		stack.push_back(i);
+	}
+}
+
+range incremental_circuit::leaf_range(size_t slot, float value) const
+{
+	return {(1.f - m_tols[slot]) * value, (1.f + m_tols[slot]) * value};
+}
+
+range incremental_circuit::combine(size_t node, range a, range b) const
+{
+	if (m_ops[node] == opcode::serial)
+		return {a.first + b.first, a.second + b.second};
+	else
+		return {parallel2(a.first, b.first), parallel2(a.second, b.second)};
+}
+
+void incremental_circuit::set(const float *values)
+{
+	// Children always precede their parents
+	for (auto i = 0u; i < m_ops.size(); i++)
+	{
+		if (m_ops[i] == opcode::leaf)
+			m_cache[i] = leaf_range(m_node_slot[i], values[m_node_slot[i]]);
+		else if (m_ops[i] != opcode::constant)
+			m_cache[i] = combine(i, m_cache[m_left[i]], m_cache[m_right[i]]);
+	}
+}
+
+// Nodes before the first leaf of the slot can't depend on it
+range incremental_circuit::probe_shared(size_t slot, float value) const
+{
+	std::int32_t first = m_leaf_node[slot];
+	auto get = [&](std::int32_t node){return node >= first ? m_scratch[node] : m_cache[node];};
+	
+	for (auto i = first; i < std::int32_t(m_ops.size()); i++)
+	{
+		if (m_ops[i] == opcode::leaf)
+			m_scratch[i] = m_node_slot[i] == std::int32_t(slot) ? leaf_range(slot, value) : m_cache[i];
+		else if (m_ops[i] == opcode::constant)
+			m_scratch[i] = m_cache[i];
+		else
+			m_scratch[i] = combine(i, get(m_left[i]), get(m_right[i]));
+	}
+	
+	return m_scratch.back();
+}
+
+range incremental_circuit::probe(size_t slot, float value) const
+{
+	if (m_shared[slot])
+		return probe_shared(slot, value);
+	
+	std::int32_t node = m_leaf_node[slot];
+	range r = leaf_range(slot, value);
+	
+	for (auto p = m_parent[node]; p >= 0; node = p, p = m_parent[p])
+	{
+		if (m_left[p] == node)
+			r = combine(p, r, m_cache[m_right[p]]);
+		else
+			r = combine(p, m_cache[m_left[p]], r);
+	}
+	
+	return r;
+}
+
+void incremental_circuit::commit(size_t slot, float value)
+{
+	if (m_shared[slot])
+	{
+		probe_shared(slot, value);
+		std::copy(m_scratch.begin() + m_leaf_node[slot], m_scratch.end(), m_cache.begin() + m_leaf_node[slot]);
+		return;
+	}
+	
+	std::int32_t node = m_leaf_node[slot];
+	m_cache[node] = leaf_range(slot, value);
+	
+	for (auto p = m_parent[node]; p >= 0; p = m_parent[p])
+		m_cache[p] = combine(p, m_cache[m_left[p]], m_cache[m_right[p]]);
+}
+
+size_t incremental_circuit::path_length(size_t slot) const
+{
+	if (m_shared[slot])
+		return m_ops.size() - m_leaf_node[slot];
+	
+	size_t n = 0;
+	for (auto p = m_parent[m_leaf_node[slot]]; p >= 0; p = m_parent[p])
+		n++;
+	return n;
+}
+
+/*
+	Returns the value of the resistor for which the lower (or upper) bound of
+	the circuit's range equals the target, with all other resistors fixed. The
+	target is propagated down the path from the root - in serial nodes, the
+	sibling is subtracted, and in parallel ones, the conductances are. FLT_MAX
+	is returned if the target can't be reached with any finite value. Shared
+	slots have no single path, so the value is bisected instead - the bounds
+	are monotone in it.
+*/
+float incremental_circuit::solve_leaf(size_t slot, float target, bool upper) const
+{
+	if (m_shared[slot])
+	{
+		auto bound = [&](float v){auto r = probe_shared(slot, v); return upper ? r.second : r.first;};
+		float lo = 0, hi = 1;
+		while (bound(hi) < target)
+		{
+			if (hi > 1e30f)
+				return FLT_MAX;
+			lo = hi;
+			hi *= 2;
+		}
+		
+		for (int i = 0; i < 32; i++)
+		{
+			float mid = (lo + hi) / 2;
+			if (bound(mid) < target)
+				lo = mid;
+			else
+				hi = mid;
+		}
+		
+		return hi;
+	}
+	
+	m_path.clear();
+	for (std::int32_t node = m_leaf_node[slot]; node >= 0; node = m_parent[node])
+		m_path.push_back(node);
+	
+	float t = target;
+	for (auto i = m_path.size() - 1; i > 0 && t < FLT_MAX; i--)
+	{
+		auto p = m_path[i], c = m_path[i - 1];
+		auto sibling = m_cache[m_left[p] == c ? m_right[p] : m_left[p]];
+		float s = upper ? sibling.second : sibling.first;
+		
+		if (m_ops[p] == opcode::serial)
+			t = std::max(t - s, 0.f);
+		else
+			t = s > t ? t * s / (s - t) : FLT_MAX;
+	}
+	
+	if (t >= FLT_MAX)
+		return FLT_MAX;
+	return t / (upper ? 1.f + m_tols[slot] : 1.f - m_tols[slot]);
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "program.hpp"
+
+/*
+	Circuit evaluator caching the range of every subtree. Nodes are stored in
+	the postfix order of the program, with links to their parents, so that a
+	change of a single leaf only requires re-evaluating the path to the root.
+	Slots shared by matched resistors have several leaves, so all nodes after
+	the first of them are re-evaluated instead.
+*/
+class incremental_circuit
+{
+public:
+	incremental_circuit(const circuit_program &prog);
+	
+	void set(const float *values);
+	range probe(size_t slot, float value) const;
+	void commit(size_t slot, float value);
+	range get() const {return m_cache.back();}
+	size_t path_length(size_t slot) const;
+	float solve_leaf(size_t slot, float target, bool upper) const;
+
+private:
+	range leaf_range(size_t slot, float value) const;
+	range combine(size_t node, range a, range b) const;
+	range probe_shared(size_t slot, float value) const;
+	
+	std::vector<opcode> m_ops;
+	std::vector<std::int32_t> m_parent;
+	std::vector<std::int32_t> m_left;
+	std::vector<std::int32_t> m_right;
+	std::vector<std::int32_t> m_leaf_node; //!< First node of each slot
+	std::vector<std::int32_t> m_node_slot; //!< Slot of each leaf node, -1 for other nodes
+	std::vector<bool> m_shared;            //!< Whether the slot has more than one leaf
+	std::vector<float> m_tols;
+	std::vector<range> m_cache;
+	mutable std::vector<std::int32_t> m_path; //!< Scratch space for solve_leaf()
+	mutable std::vector<range> m_scratch;     //!< Scratch space for probe_shared()
+};
@@ -0,0 +1,162 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+#include <thread>
+#include <algorithm>
+#include <stdexcept>
+#include <cstring>
+#include <cmath>
+#include <sstream>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+/*
+	Load generator for the daemon mode (see daemon.hpp). Every client opens its
+	own connection and sends requests one at a time, with random targets,
+	waiting for each response. Latencies of all requests are reported as
+	percentiles, along with the total throughput.
+*/
+
+struct client_result
+{
+	std::vector<double> latencies; //!< In microseconds
+	size_t errors = 0;
+};
+
+static int connect_to(const std::string &path)
+{
+	sockaddr_un addr{};
+	addr.sun_family = AF_UNIX;
+	if (path.size() >= sizeof(addr.sun_path))
+		throw std::runtime_error{"socket path too long"};
+	std::strcpy(addr.sun_path, path.c_str());
+	
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0 || connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)))
+		throw std::runtime_error{"could not connect to " + path};
+	return fd;
+}
+
+static void run_client(const std::string &path, const std::string &request, int requests, double min, double max,
+	std::uint64_t seed, client_result &result)
+{
+	using clock = std::chrono::steady_clock;
+	int fd = connect_to(path);
+	std::seed_seq seq{seed};
+	std::mt19937 rng{seq};
+	std::uniform_real_distribution<double> log_target(std::log10(min), std::log10(max));
+	
+	std::string buffer;
+	char chunk[4096];
+	for (int i = 0; i < requests; i++)
+	{
+		// Targets are spread evenly over the decades
+		std::ostringstream line;
+		line << std::setprecision(6) << request.substr(0, request.find(' ')) << " " << std::pow(10, log_target(rng));
+		if (request.find(' ') != std::string::npos)
+			line << request.substr(request.find(' '));
+		line << "\n";
+		
+		auto t0 = clock::now();
+		auto s = line.str();
+		if (send(fd, s.data(), s.size(), MSG_NOSIGNAL) != ssize_t(s.size()))
+			throw std::runtime_error{"connection closed by the daemon"};
+		
+		size_t end;
+		while ((end = buffer.find('\n')) == std::string::npos)
+		{
+			auto n = read(fd, chunk, sizeof(chunk));
+			if (n <= 0)
+				throw std::runtime_error{"connection closed by the daemon"};
+			buffer.append(chunk, n);
+		}
+		
+		result.latencies.push_back(std::chrono::duration<double, std::micro>(clock::now() - t0).count());
+		if (buffer.compare(0, 3, "ok\t"))
+			result.errors++;
+		buffer.erase(0, end + 1);
+	}
+	
+	close(fd);
+}
+
+int main(int argc, char *argv[])
+{
+	std::string path;
+	std::string request = "exact (r[rr][rr])";
+	int clients = 4;
+	int requests = 1000;
+	double min = 10, max = 1e6;
+	std::uint64_t seed = 0;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		auto next_arg = [&]() -> std::string
+		{
+			if (i + 1 >= argc)
+				throw std::runtime_error{"missing value for " + arg};
+			return argv[++i];
+		};
+		
+		if (arg == "--clients")
+			clients = std::max(1, std::stoi(next_arg()));
+		else if (arg == "--requests")
+			requests = std::max(1, std::stoi(next_arg()));
+		else if (arg == "--request")
+			request = next_arg();
+		else if (arg == "--range")
+		{
+			auto r = next_arg();
+			auto colon = r.find(':');
+			if (colon == std::string::npos)
+				throw std::runtime_error{"target range should be given as MIN:MAX"};
+			min = std::stod(r.substr(0, colon));
+			max = std::stod(r.substr(colon + 1));
+		}
+		else if (arg == "--seed")
+			seed = std::stoull(next_arg());
+		else
+			path = arg;
+	}
+	
+	if (path.empty())
+	{
+		std::cerr << "usage: " << argv[0] << " SOCKET [--clients N] [--requests N] [--request 'MODE [CIRCUIT]'] [--range MIN:MAX] [--seed N]" << std::endl;
+		return 1;
+	}
+	
+	std::vector<client_result> results(clients);
+	std::vector<std::thread> threads;
+	auto t0 = std::chrono::steady_clock::now();
+	for (int c = 0; c < clients; c++)
+		threads.emplace_back(run_client, path, request, requests, min, max, seed + c, std::ref(results[c]));
+	for (auto &t : threads)
+		t.join();
+	double time = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+	
+	std::vector<double> latencies;
+	size_t errors = 0;
+	for (const auto &r : results)
+	{
+		latencies.insert(latencies.end(), r.latencies.begin(), r.latencies.end());
+		errors += r.errors;
+	}
+	std::sort(latencies.begin(), latencies.end());
+	
+	auto percentile = [&](double p)
+	{
+		return latencies[std::min(latencies.size() - 1, size_t(p / 100 * latencies.size()))];
+	};
+	
+	std::cout << "Requests: " << latencies.size() << " (" << clients << " clients, " << errors << " errors)" << std::endl;
+	std::cout << "Throughput: " << std::fixed << std::setprecision(1) << latencies.size() / time << " requests/s" << std::endl;
+	std::cout << "Latency (us):" << std::endl;
+	for (auto [name, p] : {std::pair{"p50", 50.0}, {"p90", 90.0}, {"p99", 99.0}, {"p99.9", 99.9}, {"max", 100.0}})
+		std::cout << "\t" << std::setw(8) << std::left << name << std::setw(12) << std::right << percentile(p) << std::endl;
+	
+	return 0;
+}
@@ -1,4 +1,6 @@
 #include <iostream>
+#include <fstream>
+#include <chrono>
 #include <limits>
 #include <vector>
 #include <memory>
@@ -7,405 +9,709 @@
 #include <sstream>
 #include <cmath>
 #include <iomanip>
+#include <cfloat>
 #include <random>
 #include <array>
 #include <set>
+#include <optional>
+#include <tuple>
+#include "circuit.hpp"
+#include "program.hpp"
+#include "search.hpp"
+#include "exact.hpp"
+#include "topology.hpp"
+#include "pareto.hpp"
+#include "series.hpp"
+#include "yield.hpp"
+#include "targets.hpp"
+#include "strategy.hpp"
+#include "compare.hpp"
+#include "netlist.hpp"
+#include "impedance.hpp"
+#include "divider.hpp"
+#include "cache.hpp"
+#include "daemon.hpp"
+#include "telemetry.hpp"
 
-constexpr auto INF = std::numeric_limits<float>::infinity();
-using range = std::pair<float, float>;
-
-static std::string to_si_string(float x)
+static std::string json_string(const std::string &str)
 {
-	if (x == 0)
-		return "0";
-	
-	int e = std::floor(std::log10(std::abs(x)));
-	int i = std::clamp(e / 3 + 3, 0, 6);
-	static const char *prefixes[] = {"n", "u", "m", "", "k", "M", "G"};
-	static const int exps[] = {-9, -6, -3, 0, 3, 6, 9};
-	
 	std::stringstream ss;
-	ss << x / std::pow(10, exps[i]) << prefixes[i];
+	ss << '"';
+	for (auto c : str)
+	{
+		if (c == '"' || c == '\\')
+			ss << '\\' << c;
+		else if (static_cast<unsigned char>(c) < 0x20)
+			ss << "\\u" << std::hex << std::setw(4) << std::setfill('0') << int(c) << std::dec;
+		else
+			ss << c;
+	}
+	ss << '"';
 	return ss.str();
 }
 
-float from_si_string(const std::string &s)
+int main(int argc, char *argv[])
 {
-	static const std::array<std::string, 7> prefixes = {"p", "n", "u", "m", "k", "M", "G"};
-	static const std::array<int, 7> exps = {-12, -9, -6, -3, 3, 6, 9};
+	std::vector<std::string> args;
+	bool exact = false;
+	int topologies = 0;
+	std::string series = "E12";
+	bool yield = false;
+	float tolerance = 0.01f;
+	yield_config ycfg;
+	int first_decade = 0, last_decade = 5;
+	std::string batch_file;
+	bool json = false;
+	bool compare = false;
+	bool pareto = false;
+	std::string netlist_file;
+	std::string cache_file;
+	std::string daemon_socket;
+	std::string telemetry_file;
+	std::vector<impedance_target> ac_targets;
+	std::string cap_series = "E6";
+	std::string ind_series = "E6";
+	int cap_first_decade = -12, cap_last_decade = -4;
+	int ind_first_decade = -9, ind_last_decade = -1;
+	std::vector<float> divider_ratios;
+	size_t segment_size = 1;
+	int restarts = 100;
+	search_config cfg;
+	cfg.seed = std::random_device{}();
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		auto next_arg = [&]() -> std::string
+		{
+			if (i + 1 >= argc)
+				throw std::runtime_error{"missing value for " + arg};
+			return argv[++i];
+		};
+		
+		if (arg == "--exact")
+			exact = true;
+		else if (arg == "--topologies")
+			topologies = std::stoi(next_arg());
+		else if (arg == "--series")
+			series = next_arg();
+		else if (arg == "--decades" || arg == "--cap-decades" || arg == "--ind-decades")
+		{
+			auto decades = next_arg();
+			auto colon = decades.find(':');
+			if (colon == std::string::npos)
+				throw std::runtime_error{"decade range should be given as MIN:MAX"};
+			
+			auto &first = arg == "--decades" ? first_decade : arg == "--cap-decades" ? cap_first_decade : ind_first_decade;
+			auto &last = arg == "--decades" ? last_decade : arg == "--cap-decades" ? cap_last_decade : ind_last_decade;
+			first = std::stoi(decades.substr(0, colon));
+			last = std::stoi(decades.substr(colon + 1));
+		}
+		else if (arg == "--cap-series")
+			cap_series = next_arg();
+		else if (arg == "--ind-series")
+			ind_series = next_arg();
+		else if (arg == "--ac")
+			ac_targets.push_back(parse_impedance_target(next_arg()));
+		else if (arg == "--divider")
+			divider_ratios = parse_ratios(next_arg());
+		else if (arg == "--segment")
+			segment_size = std::max(1, std::stoi(next_arg()));
+		else if (arg == "--yield")
+		{
+			yield = true;
+			ycfg.spec = std::stof(next_arg()) / 100;
+		}
+		else if (arg == "--tolerance")
+			tolerance = std::stof(next_arg()) / 100;
+		else if (arg == "--samples")
+			ycfg.samples = std::max(1ll, std::stoll(next_arg()));
+		else if (arg == "--batch")
+			batch_file = next_arg();
+		else if (arg == "--restarts")
+			restarts = std::max(1, std::stoi(next_arg()));
+		else if (arg == "--time-limit")
+			cfg.time_limit = std::stod(next_arg());
+		else if (arg == "--max-evals")
+			cfg.max_evals = std::stoull(next_arg());
+		else if (arg == "--stall-generations")
+			cfg.stall_generations = std::stoull(next_arg());
+		else if (arg == "--json")
+			json = true;
+		else if (arg == "--telemetry")
+			telemetry_file = next_arg();
+		else if (arg == "--sample-interval")
+			cfg.sample_interval = std::max(1e-3, std::stod(next_arg()));
+		else if (arg == "--compare")
+			compare = true;
+		else if (arg == "--pareto")
+			pareto = true;
+		else if (arg == "--daemon")
+			daemon_socket = next_arg();
+		else if (arg == "--cache")
+			cache_file = next_arg();
+		else if (arg == "--netlist")
+			netlist_file = next_arg();
+		else if (arg == "--strategy")
+			cfg.strategy = next_arg();
+		else if (arg == "--steepest")
+			cfg.strategy = "steepest";
+		else if (arg == "-j")
+			cfg.threads = std::max(1, std::stoi(next_arg()));
+		else if (arg == "--seed")
+			cfg.seed = std::stoull(next_arg());
+		else
+			args.push_back(arg);
+	}
+	
+
+	// Shorts and opens are only useful when the topology is fixed - the Pareto
+	// search would count them as parts and values, and divider chains are
+	// series only
+	bool shorts_opens = !topologies && !pareto && divider_ratios.empty();
+	std::vector<float> avail = make_eseries_values(series, first_decade, last_decade);
+	if (shorts_opens) avail.push_back(0);
+	if (shorts_opens) avail.push_back(1e9);
+	
+	
 	
-	std::istringstream ss(s);
-	float base;
-	ss >> base;
+	// In batch, impedance, divider and daemon modes, targets are given in other ways
+	bool batch = !batch_file.empty();
+	bool ac = !ac_targets.empty();
+	bool daemon = !daemon_socket.empty();
+	bool divider = !divider_ratios.empty();
+	size_t circuit_arg = batch || ac || divider || daemon ? 0 : 1;
 	
-	std::string sexp;
-	std::getline(ss, sexp);
-	int e = 0;
+	float tval = 5843;
+	if (args.size() > 0 && !batch && !ac && !divider && !daemon) tval = from_si_string(args[0]);
+	
+	range target = {tval, tval};
 	
-	if (!sexp.empty())
+	// In topology search, netlist, divider and daemon modes, there's no circuit argument
+	bool use_netlist = !netlist_file.empty();
+	std::string circuit_desc = "(r[rr][rr])";
+	size_t values_arg = topologies || use_netlist || divider || daemon ? circuit_arg : circuit_arg + 1;
+	if (args.size() > circuit_arg && !topologies && !use_netlist && !divider && !daemon) circuit_desc = args[circuit_arg];
+	auto circuit = str_to_circuit(circuit_desc);
+	
+	std::unique_ptr<netlist> net;
+	if (use_netlist)
 	{
-// 		std::cout << "sexp: '" << sexp << "'" << std::endl;
-		bool match = false;
-		for (auto i = 0u; i < prefixes.size(); i++)
-			if (sexp == prefixes[i])
-			{
-				e = exps[i];
-				match = true;
-				break;
-			}
+		if (exact || topologies || yield || pareto || !batch_file.empty() || cfg.strategy != "descent")
+			throw std::runtime_error{"netlists only support the default search"};
 		
-		if (!match)
-			throw std::runtime_error{"invalid SI prefix"};
+		std::ifstream f(netlist_file);
+		if (!f)
+			throw std::runtime_error{"could not open " + netlist_file};
+		net = std::make_unique<netlist>(f);
 	}
 	
-	return base * std::pow(10, e);
-}
-
-struct resistance
-{
-	virtual ~resistance() = default;
-	virtual float est_max() const = 0;
-	virtual float est_min() const = 0;
-	virtual std::vector<float*> get_resistances() = 0;
-	virtual std::string describe() const = 0;
-	range est_range() const {return {est_min(), est_max()};}
-};
-
-struct resistor : public resistance
-{	
-	virtual ~resistor() = default;
-	float est_max() const override {return (1.f + tol) * value;}
-	float est_min() const override {return (1.f - tol) * value;}
-	std::vector<float*> get_resistances() override {return {&value};}
-	std::string describe() const override {return to_si_string(value);}
-	
-	float value = 100.f;
-	float tol = 0.0f;
-};
-
-struct resistance_block : public resistance
-{
-	virtual ~resistance_block() = default;
-	
-	void add(std::shared_ptr<resistance> ptr) {resistances.push_back(ptr);}
-	int get_children_count() const {return resistances.size();}
+	if (compile_circuit(*circuit).reactive() != ac)
+		throw std::runtime_error{ac ? "impedance targets need a circuit with capacitors or inductors" : "capacitors and inductors need impedance targets (--ac)"};
+	if (ac && (exact || topologies || yield || pareto || batch || compare || cfg.strategy != "descent"))
+		throw std::runtime_error{"impedance targets only support the default search"};
 	
-	std::vector<std::shared_ptr<resistance>> resistances;
-};
-
-struct parallel : public resistance_block
-{
-	virtual ~parallel() = default;
+	std::unique_ptr<divider_chain> chain;
+	if (divider)
+	{
+		if (exact || topologies || yield || pareto || batch || compare || use_netlist || ac || daemon || cfg.strategy != "descent")
+			throw std::runtime_error{"dividers only support the default search"};
+		chain = std::make_unique<divider_chain>(divider_ratios, segment_size);
+	}
 	
-	float est_max() const override
+	if (args.size() > values_arg)
 	{
-		float ret = 0.f;
-		for (const auto &r : resistances)
+		std::set<float> values;
+		for (auto i = values_arg; i < args.size(); i++)
+			values.insert(from_si_string(args[i]));
+		
+		if (values.size() <= 1)
 		{
-			auto x = r->est_max();
-			if (x == 0.f) return 0;
-			ret += 1.f / x;
+			std::cerr << "please specify more than one reistor value" << std::endl;
+			return 1;
 		}
-		return 1.f / ret;
+			
+		avail.assign(values.begin(), values.end());
 	}
+
+	std::sort(avail.begin(), avail.end());
+
+	// Batch results and JSON are written to stdout, so everything else goes to stderr
+	std::ostream &info = batch || json ? std::cerr : std::cout;
+	info << "Available values: ";
+	for (auto r : avail)
+		info << to_si_string(r) << " ";
+	info << std::endl;
 	
-	float est_min() const override
+	// Capacitors and inductors take their values from separate ranges of avail
+	std::vector<std::pair<size_t, size_t>> kind_ranges{{0, avail.size()}};
+	if (ac)
 	{
-		float ret = 0.f;
-		for (const auto &r : resistances)
+		for (auto [kind, eseries, first, last, unit] : {std::tuple{"capacitor", &cap_series, cap_first_decade, cap_last_decade, "F"},
+			{"inductor", &ind_series, ind_first_decade, ind_last_decade, "H"}})
 		{
-			auto x = r->est_min();
-			if (x == 0.f) return 0;
-			ret += 1.f / x;
+			auto values = make_eseries_values(*eseries, first, last);
+			kind_ranges.push_back({avail.size(), avail.size() + values.size()});
+			avail.insert(avail.end(), values.begin(), values.end());
+			
+			info << "Available " << kind << " values: ";
+			for (auto v : values)
+				info << to_si_string(v) << unit << " ";
+			info << std::endl;
 		}
-		return 1.f / ret;
 	}
 	
-	std::vector<float*> get_resistances() override
+	// Solutions depend on the circuit (or the set of topologies) and the available
+	// values, apart from the target - yield analysis isn't cached
+	std::unique_ptr<solution_cache> cache;
+	std::string cache_circuit = topologies ? "topologies:" + std::to_string(topologies) : canonical_form(*circuit);
+	std::string cache_values = values_id(avail);
+	auto make_cache_key = [&](float t){return cache_key{cache_circuit, cache_values, t};};
+	if (!cache_file.empty())
 	{
-		std::vector<float*> v;
-		for (auto &r : resistances)
-		{
-			auto sub = r->get_resistances();
-			v.insert(v.end(), sub.begin(), sub.end());
-		}
-		
-		return v;
+		if (!(batch || daemon || (exact && !topologies)) || yield || pareto || ac || use_netlist || compare)
+			throw std::runtime_error{"the cache is only supported in batch and daemon modes, and by the exact search"};
+		cache = std::make_unique<solution_cache>(cache_file);
 	}
 	
-	std::string describe() const override
+	if (!telemetry_file.empty() && (batch || daemon || exact || topologies || pareto || compare))
+		throw std::runtime_error{"telemetry is only supported by the restart search"};
+	
+	if (daemon)
 	{
-		std::stringstream ss;
-		ss << "(";
-		for (auto i = 0u; i < resistances.size(); i++)
+		if (batch || exact || yield || pareto || ac || use_netlist || compare)
+			throw std::runtime_error{"the daemon mode is only supported with --topologies, -j, --restarts, --strategy and --cache"};
+		
+		std::unique_ptr<topology_solver> tsolver;
+		if (topologies)
 		{
-			ss << resistances[i]->describe();
-			if (i != resistances.size() - 1)
-				ss << " | ";
+			tsolver = std::make_unique<topology_solver>(avail, topologies);
+			tsolver->prepare();
 		}
-		ss << ")";
 		
-		return ss.str();
+		info << "Listening on " << daemon_socket << " (" << cfg.threads << " threads)" << std::endl;
+		run_daemon(daemon_socket, avail, {cfg.threads, restarts, cfg.seed, cfg.strategy, tsolver.get(), topologies, cache.get()});
+		return 0;
 	}
-};
-
-struct serial : public resistance_block
-{
-	virtual ~serial() = default;
 	
-	float est_max() const override
+	if (compare)
 	{
-		float ret = 0;
-		for (const auto &r : resistances)
-			ret += r->est_max();
-		return ret;
+		if (cfg.time_limit <= 0)
+			cfg.time_limit = 1;
+		compare_strategies(avail, cfg, 1e-6f, std::cout);
+		return 0;
 	}
 	
-	float est_min() const override
+	if (batch)
 	{
-		float ret = 0;
-		for (const auto &r : resistances)
-			ret += r->est_min();
-		return ret;
-	}
-	
-	std::vector<float*> get_resistances() override
-	{
-		std::vector<float*> v;
-		for (auto &r : resistances)
+		if (yield || pareto)
+			throw std::runtime_error{"yield analysis and Pareto search are not supported in batch mode"};
+		
+		std::vector<float> targets;
+		if (batch_file == "-")
+		{
+			targets = read_targets(std::cin);
+		}
+		else
 		{
-			auto sub = r->get_resistances();
-			v.insert(v.end(), sub.begin(), sub.end());
+			std::ifstream f{batch_file};
+			if (!f)
+				throw std::runtime_error{"could not open " + batch_file};
+			targets = read_targets(f);
 		}
 		
-		return v;
+		// Everything independent of the target is set up only once - the topology
+		// tables, and the compiled circuit with a copy of it for every thread
+		auto t0 = std::chrono::steady_clock::now();
+		std::unique_ptr<topology_solver> tsolver;
+		if (topologies)
+		{
+			tsolver = std::make_unique<topology_solver>(avail, topologies);
+			tsolver->prepare();
+		}
+		
+		auto prog = compile_circuit(*circuit);
+		std::vector<std::shared_ptr<resistance_block>> circuits;
+		std::vector<std::unique_ptr<search_strategy>> strategies;
+		for (auto i = 0u; i < cfg.threads; i++)
+		{
+			circuits.push_back(str_to_circuit(circuit_desc));
+			strategies.push_back(make_strategy(cfg.strategy, prog, avail, target));
+		}
+		
+		auto t1 = std::chrono::steady_clock::now();
+		
+		auto solve_target = [&](size_t index, unsigned thread) -> cached_solution
+		{
+			float t = targets[index];
+			range rt{t, t};
+			
+			if (topologies)
+			{
+				// Nothing can beat an exact match
+				topology_solution best{-1, -INF, {0, 0}, "", false, {}};
+				for (auto i = 0u; i < tsolver->get_topologies().size() && best.score < 0; i++)
+				{
+					auto sol = tsolver->solve(i, rt, best.score);
+					if (sol.score > best.score)
+						best = sol;
+				}
+				
+				return {best.rg, best.score, true, best.desc};
+			}
+			
+			auto &circ = *circuits[thread];
+			if (exact)
+			{
+				exact_solver solver(circ, avail, rt);
+				solver.solve([](const exact_solver &){});
+				return {solver.best_range, solver.best_score, true, solver.best_desc()};
+			}
+			
+			// Restarts are seeded with the target's position, so results don't depend on the threads
+			std::seed_seq seq{cfg.seed, static_cast<std::uint64_t>(index)};
+			std::mt19937 rng{seq};
+			auto &strategy = *strategies[thread];
+			strategy.reset(rt);
+			
+			solution best;
+			for (int r = 0; r < restarts && best.score < 0; r++)
+			{
+				const auto &sol = strategy.step(rng);
+				if (sol.score > best.score)
+					best = sol;
+			}
+			
+			auto res = circ.get_resistances();
+			for (auto i = 0u; i < res.size(); i++)
+				*res[i] = avail[best.indices[i]];
+			return {best.rg, best.score, best.score >= 0, circ.describe()};
+		};
+		
+		// Proven optimal solutions are good for any search, best known ones only for the heuristic one
+		auto solve = [&](size_t index, unsigned thread) -> target_result
+		{
+			float t = targets[index];
+			std::optional<cached_solution> sol;
+			if (cache)
+				sol = cache->find(make_cache_key(t));
+			if (!sol || !(sol->optimal || !(exact || topologies)))
+			{
+				sol = solve_target(index, thread);
+				if (cache)
+					cache->store(make_cache_key(t), *sol);
+			}
+			
+			return {t, (sol->rg.first + sol->rg.second) / 2, sol->desc};
+		};
+		
+		solve_targets(targets, cfg.threads, solve, [](size_t, const target_result &r){
+			float error = r.target != 0 ? (r.value - r.target) / r.target * 100 : 0;
+			std::cout << to_si_string(r.target) << "\t" << r.value << "\t" << error << "%\t" << r.desc << "\n";
+		});
+		std::cout.flush();
+		
+		auto t2 = std::chrono::steady_clock::now();
+		double setup_time = std::chrono::duration<double>(t1 - t0).count();
+		double solve_time = std::chrono::duration<double>(t2 - t1).count();
+		std::cerr << "Solved " << targets.size() << " targets in " << solve_time << " s ("
+			<< targets.size() / solve_time << " targets/s, " << cfg.threads << " threads, setup " << setup_time << " s)" << std::endl;
+		return 0;
 	}
 	
-	std::string describe() const override
+	if (pareto)
 	{
-		std::stringstream ss;
-		ss << "(";
-		for (auto i = 0u; i < resistances.size(); i++)
+		// With --topologies, every network is added to the same archive
+		pareto_archive archive(topologies ? topologies : circuit->get_resistances().size());
+		if (topologies)
 		{
-			ss << resistances[i]->describe();
-			if (i != resistances.size() - 1)
-				ss << " + ";
+			topology_solver solver(avail, topologies);
+			const auto &topos = solver.get_topologies();
+			for (auto i = 0u; i < topos.size(); i++)
+				pareto_search(topos[i].desc, avail, target, archive, &solver, i);
+		}
+		else
+		{
+			pareto_search(circuit_desc, avail, target, archive);
+		}
+		
+		std::cout << "\n\nPareto front (" << archive.front().size() << " solutions)" << std::endl;
+		std::cout << "parts\tvalues\terror\tdescription" << std::endl;
+		for (const auto &p : archive.front())
+		{
+			float value = (p.rg.first + p.rg.second) / 2;
+			float error = target.first != 0 ? (value - target.first) / target.first * 100 : 0;
+			std::cout << p.parts << "\t" << p.distinct << "\t" << error << "%\t" << p.desc << std::endl;
 		}
-		ss << ")";
 		
-		return ss.str();
+		return 0;
 	}
-};
-
-std::unique_ptr<resistance> par(std::vector<std::shared_ptr<resistance>> l)
-{
-	auto ptr = std::make_unique<parallel>();
-	ptr->resistances = l;
-	return std::move(ptr);
-}
-
-std::unique_ptr<resistance> ser(std::initializer_list<std::shared_ptr<resistance>> l)
-{
-	auto ptr = std::make_unique<serial>();
-	ptr->resistances = l;
-	return std::move(ptr);
-}
-
-std::unique_ptr<resistance> res(float r = 100.f, float tol = 0.0f)
-{
-	auto ptr = std::make_unique<resistor>();
-	ptr->value = r;
-	ptr->tol = tol;
-	return std::move(ptr);
-}
-
-float range_score(const range &target, const range &r)
-{
-	return -std::abs(target.first - r.first) - std::abs(target.second - r.second);
-}
-
-struct res_change
-{
-	size_t res_id;
-	size_t val_id;
-	range rg;
-};
-
-auto str_to_circuit(const std::string &s)
-{
-	std::vector<std::shared_ptr<resistance_block>> stack;
 	
-	for (char c : s)
+	if (topologies)
 	{
-		switch (c)
+		topology_solver solver(avail, topologies);
+		const auto &topos = solver.get_topologies();
+		
+		topology_solution best{-1, -INF, {0, 0}, "", false, {}};
+		for (int n = 1; n <= topologies; n++)
 		{
-			case '[':
-				stack.push_back(std::make_shared<parallel>());
-				break;
-			
-			case '(':
-				stack.push_back(std::make_shared<serial>());
-				break;
-				
-			case 'R':
-			case 'r':
-				if (stack.empty())
-					throw std::runtime_error{"invalid circ - cannot add resistor, no block"};
-			
-				stack.back()->add(std::make_shared<resistor>());
-				break;
-				
-			case ']':
-			case ')':
+			int count = 0;
+			topology_solution best_n{-1, -INF, {0, 0}, "", false, {}};
+			for (auto i = 0u; i < topos.size(); i++)
 			{
-				if (stack.empty())
-					throw std::runtime_error{"invalid circ description (stack empty and closing)"};
-				
-				if (stack.size() == 1)
-					return stack.back();
-				
-				auto top = stack.back();
-				stack.pop_back();
+				if (topos[i].leaves != n)
+					continue;
 				
-				if (top->get_children_count() == 0)
-					throw std::runtime_error{"invalid circ - empty block"};
+				// Nothing can beat an exact match
+				count++;
+				if (best_n.score == 0)
+					continue;
 				
-				stack.back()->add(top);
-				break;
-			}	
+				auto sol = solver.solve(i, target, best_n.score);
+				if (sol.score > best_n.score)
+					best_n = sol;
+			}
+			
+			std::cout << "\n\nBest network of " << n << " resistor(s) (" << count << " topologies)" << std::endl;
+			std::cout << "\tTopology: " << topos[best_n.id].desc << std::endl;
+			std::cout << "\tDescription: " << best_n.desc << std::endl;
+			std::cout << "\tRange: [" << best_n.rg.first << ", " << best_n.rg.second << "]" << std::endl;
+			std::cout << "\tTarget: [" << target.first << ", " << target.second << "]" << std::endl;
+			std::cout << "\tScore: " << best_n.score << std::endl;
+			
+			if (best_n.score > best.score)
+				best = best_n;
 		}
+		
+		std::cout << "\n\nBest network overall: " << best.desc << " (score " << best.score << ")" << std::endl;
+		return 0;
 	}
 	
-	throw std::runtime_error{"invalid circ - stack not empty"};
-}
-
-int main(int argc, char *argv[])
-{
-	std::vector<float> basic{
-		1.0, 1.2, 1.5, 1.8, 2.2, 2.7, 3.3, 3.9, 4.7, 5.6, 6.8, 8.2,
+	if (exact)
+	{
+		if (auto hit = cache ? cache->find(make_cache_key(tval)) : std::nullopt; hit && hit->optimal)
+		{
+			std::cout << "\n\nCached solution" << std::endl;
+			std::cout << "\tDescription: " << hit->desc << std::endl;
+			std::cout << "\tRange: [" << hit->rg.first << ", " << hit->rg.second << "]" << std::endl;
+			std::cout << "\tTarget: [" << target.first << ", " << target.second << "]" << std::endl;
+			std::cout << "\tScore: " << hit->score << std::endl;
+			std::cout << "\n\nThe solution is optimal (found in the cache)" << std::endl;
+			return 0;
+		}
+		
+		exact_solver solver(*circuit, avail, target);
+		int solution = 0;
+		solver.solve([&](const exact_solver &s){
+			std::cout << "\n\nSolution " << solution << " (node " << s.nodes << ")" << std::endl;
+			std::cout << "\tDescription: " << s.best_desc() << std::endl;
+			std::cout << "\tRange: [" << s.best_range.first << ", " << s.best_range.second << "]" << std::endl;
+			std::cout << "\tTarget: [" << target.first << ", " << target.second << "]" << std::endl;
+			std::cout << "\tScore: " << s.best_score << std::endl;
+			solution++;
+		});
+		
+		std::cout << "\n\nSearch complete - solution " << solution - 1 << " is optimal (" << solver.nodes << " nodes visited)" << std::endl;
+		if (cache)
+			cache->store(make_cache_key(tval), {solver.best_range, solver.best_score, true, solver.best_desc()});
+		return 0;
+	}
+	
+	auto res = circuit->get_resistances();
+	auto prog = compile_circuit(*circuit);
+	
+	auto describe_solution = [&res, &circuit, &net, &chain, &avail](const std::vector<size_t> &ind)
+	{
+		if (net || chain)
+		{
+			std::vector<float> values(ind.size());
+			for (auto i = 0u; i < ind.size(); i++)
+				values[i] = avail[ind[i]];
+			return net ? net->describe(values.data()) : chain->describe(values.data());
+		}
+		
+		for (auto i = 0u; i < ind.size(); i++)
+			*res[i] = avail[ind[i]];
+		
+		return circuit->describe();
 	};
 	
-	std::vector<float> avail;
-	avail.push_back(0);
-	for (int i = 0; i < 6; i++)
-		for (auto r : basic)
-			avail.push_back(r * std::pow(10, i));
-	avail.push_back(1e9);
+	// In yield mode, the search is steered by the fraction of Monte Carlo samples
+	// in spec rather than the nominal resistance
+	auto yield_prog = prog;
+	std::fill(yield_prog.tols.begin(), yield_prog.tols.end(), tolerance);
+	ycfg.seed = cfg.seed;
 	
+	auto analyze = [&](const std::vector<size_t> &ind)
+	{
+		std::vector<float> values(ind.size());
+		for (auto i = 0u; i < ind.size(); i++)
+			values[i] = avail[ind[i]];
+		return estimate_yield(yield_prog, values.data(), tval, ycfg);
+	};
 	
+	if (yield)
+		cfg.rescore = [&](const solution &sol){return analyze(sol.indices).yield;};
 	
-	float tval = 5843;
-	if (argc > 1) tval = from_si_string(argv[1]);
+	if (yield)
+		cfg.stop_score = 1;
 	
-	range target = {tval, tval};
+	// Without any parts to choose, the first solution is the only one
+	if (!net && !chain && prog.size() == 0)
+		cfg.stop_score = -FLT_MAX;
 	
-	std::shared_ptr<resistance> circuit = ser({
-		res(),
-		par({ res(), res() }),
-		par({ res(), res() })
-	});
+	info << "Seed: " << cfg.seed << ", threads: " << cfg.threads << std::endl;
 	
-	if (argc > 2) circuit = str_to_circuit(argv[2]);
+	strategy_factory make = [&]{
+		if (ac)
+			return make_impedance_strategy(prog, avail, kind_ranges, ac_targets);
+		if (chain)
+			return make_divider_strategy(*chain, avail);
+		return net ? make_netlist_strategy(*net, avail, target) : make_strategy(cfg.strategy, prog, avail, target);
+	};
 	
-	if (argc > 3)
+	// Magnitude and phase (in degrees) at every target frequency
+	std::unique_ptr<impedance_evaluator> zeval;
+	if (ac)
 	{
-		std::set<float> values;
-		for (int i = 3; i < argc; i++)
-			values.insert(from_si_string(argv[i]));
-		
-		if (values.size() <= 1)
-		{
-			std::cerr << "please specify more than one reistor value" << std::endl;
-			return 1;
-		}
-			
-		avail.assign(values.begin(), values.end());
+		std::vector<float> frequencies;
+		for (const auto &t : ac_targets)
+			frequencies.push_back(t.frequency);
+		zeval = std::make_unique<impedance_evaluator>(prog, frequencies);
 	}
-
-	std::sort(avail.begin(), avail.end());
-
-	std::cout << "Available values: ";
-	for (auto r : avail)
-		std::cout << to_si_string(r) << " ";
-	std::cout << std::endl;
-	
-	auto res = circuit->get_resistances();
 	
-	auto est_solution = [&res, &circuit, &avail](const std::vector<size_t> &ind)
+	auto impedances = [&](const std::vector<size_t> &ind)
 	{
+		std::vector<float> values(ind.size()), re(ac_targets.size()), im(ac_targets.size());
 		for (auto i = 0u; i < ind.size(); i++)
-			*res[i] = avail[ind[i]];
+			values[i] = avail[ind[i]];
+		zeval->eval(values.data(), re.data(), im.data());
 		
-		return circuit->est_range();
+		std::vector<std::pair<float, float>> z;
+		for (auto i = 0u; i < re.size(); i++)
+			z.push_back({std::hypot(re[i], im[i]), std::atan2(im[i], re[i]) * float(180 / M_PI)});
+		return z;
 	};
 	
-	std::string best_desc;
-	float best_score = -INF;
-	range best_range;
-	int solution = 0;
-	
-	std::mt19937 rng{std::random_device{}()};
-	std::uniform_int_distribution<size_t> dist(0, avail.size() - 1);
+	std::unique_ptr<telemetry_writer> telemetry;
+	if (!telemetry_file.empty())
+	{
+		telemetry = std::make_unique<telemetry_writer>(telemetry_file);
+		cfg.on_sample = [&](const telemetry_sample &s){telemetry->write(s);};
+	}
 	
-	for (int generation = 0; ; generation++)
+	auto tap_ratios = [&](const std::vector<size_t> &ind)
 	{
-		std::vector<size_t> indices(res.size());
-		for (auto &i : indices)
-			i = dist(rng);
-		
-		float last_score = -INF;
-		range last_range;
-		std::string last_desc;
-		for (int iteration = 0;; iteration++)
+		std::vector<float> values(ind.size()), taps(chain->ratios.size());
+		for (auto i = 0u; i < ind.size(); i++)
+			values[i] = avail[ind[i]];
+		chain->taps(values.data(), taps.data());
+		return taps;
+	};
+	
+	int solution = 0;
+	auto summary = restart_search(make, cfg, [&](const search_report &report){
+		info << "\n\nSolution " << solution << " (thread " << report.thread << ", generation " << report.generation << ")" << std::endl;
+		info << "\tDescription: " << describe_solution(report.sol.indices) << std::endl;
+		if (ac)
 		{
-			std::vector<res_change> changes;
-			for (auto i = 0u; i < indices.size(); i++)
+			auto z = impedances(report.sol.indices);
+			for (auto i = 0u; i < z.size(); i++)
 			{
-				if (indices[i] != 0) changes.push_back({i, indices[i] - 1, {0, 0}});
-				if (indices[i] != avail.size() - 1) changes.push_back({i, indices[i] + 1, {0, 0}});
+				const auto &t = ac_targets[i];
+				info << "\tAt " << to_si_string(t.frequency) << "Hz: " << to_si_string(z[i].first) << " at " << z[i].second << " deg (target "
+					<< to_si_string(t.magnitude);
+				if (t.has_phase)
+					info << " at " << t.phase << " deg";
+				info << ")" << std::endl;
 			}
+		}
+		else if (chain)
+		{
+			auto taps = tap_ratios(report.sol.indices);
+			for (auto i = 0u; i < taps.size(); i++)
+				info << "\tTap " << i << ": " << taps[i] << " (target " << chain->ratios[i] << ", error "
+					<< (taps[i] - chain->ratios[i]) / chain->ratios[i] * 100 << "%)" << std::endl;
+			info << "\tTotal: " << report.sol.rg.first << std::endl;
+		}
+		else
+		{
+			info << "\tRange: [" << report.sol.rg.first << ", " << report.sol.rg.second << "]" << std::endl;
+			info << "\tTarget: [" << target.first << ", " << target.second << "]" << std::endl;
+		}
+		info << "\tScore: " << report.sol.score << std::endl;
+		
+		if (yield)
+		{
+			auto y = analyze(report.sol.indices);
+			info << "\tYield: " << y.yield * 100 << "% within +/-" << ycfg.spec * 100 << "% (" << y.samples << " samples)" << std::endl;
+			info << "\tDistribution: mean " << y.mean << ", stddev " << y.stddev << ", min " << y.min << ", max " << y.max << std::endl;
 			
-			if (changes.empty())
-				throw std::runtime_error{"no changes"};
-			
-			for (auto &chg : changes)
+			float bin_width = (y.histogram_range.second - y.histogram_range.first) / y.histogram.size();
+			for (auto i = 0u; i < y.histogram.size(); i++)
 			{
-				auto ind = indices;
-				ind[chg.res_id] = chg.val_id;
-				chg.rg = est_solution(ind);
+				float share = float(y.histogram[i]) / y.samples;
+				info << "\t\t" << std::setw(10) << y.histogram_range.first + i * bin_width << " "
+					<< std::setw(6) << std::fixed << std::setprecision(2) << share * 100 << "% "
+					<< std::string(std::lround(share * 200), '#') << std::defaultfloat << std::setprecision(6) << std::endl;
 			}
-			
-			std::sort(changes.begin(), changes.end(), [&target](const auto &lhs, const auto &rhs){
-				return range_score(target, lhs.rg) > range_score(target, rhs.rg);
-			});
-			
-			if (range_score(target, changes[0].rg) <= last_score)
-				break;
-			
-			indices[changes[0].res_id] = changes[0].val_id;
-			last_range = est_solution(indices);
-			last_score = range_score(target, last_range);
-			last_desc = circuit->describe();
 		}
 		
-		if (last_score > best_score)
+		solution++;
+	});
+	
+	double evals_per_second = summary.evals / std::max(summary.time, 1e-9);
+	if (!json)
+	{
+		std::cout << "\n\nSearch stopped - " << summary.stop_reason << std::endl;
+		std::cout << "\tGenerations: " << summary.generations << std::endl;
+		std::cout << "\tEvaluations: " << summary.evals << " (" << evals_per_second << "/s)" << std::endl;
+		std::cout << "\tTime: " << summary.time << " s (best solution found after " << summary.time_to_best << " s)" << std::endl;
+		return 0;
+	}
+	
+	const auto &best = summary.best;
+	std::cout << std::setprecision(9) << "{\n";
+	if (ac)
+	{
+		auto z = impedances(best.indices);
+		std::cout << "\t\"impedance\": [";
+		for (auto i = 0u; i < z.size(); i++)
 		{
-			best_score = last_score;
-			best_desc = last_desc;
-			best_range = last_range;
-			
-			std::cout << "\n\nSolution " << solution << " (generation " << generation << ")" << std::endl;
-			std::cout << "\tDescription: " << best_desc << std::endl;
-			std::cout << "\tRange: [" << best_range.first << ", " << best_range.second << "]" << std::endl;
-			std::cout << "\tTarget: [" << target.first << ", " << target.second << "]" << std::endl;
-			std::cout << "\tScore: " << best_score << std::endl;
-			solution++;
-			
-// 			if (best_score == 0)
-// 				break;
+			const auto &t = ac_targets[i];
+			std::cout << (i ? ", " : "") << "{\"frequency\": " << t.frequency << ", \"magnitude\": " << z[i].first << ", \"phase\": " << z[i].second
+				<< ", \"target_magnitude\": " << t.magnitude;
+			if (t.has_phase)
+				std::cout << ", \"target_phase\": " << t.phase;
+			std::cout << "}";
 		}
+		std::cout << "],\n";
 	}
-	
+	else if (chain)
+	{
+		auto taps = tap_ratios(best.indices);
+		std::cout << "\t\"taps\": [";
+		for (auto i = 0u; i < taps.size(); i++)
+			std::cout << (i ? ", " : "") << "{\"ratio\": " << taps[i] << ", \"target_ratio\": " << chain->ratios[i] << "}";
+		std::cout << "],\n";
+	}
+	else
+		std::cout << "\t\"target\": " << tval << ",\n";
+	std::cout << "\t\"circuit\": " << json_string(net ? netlist_file : chain ? "divider" : circuit_desc) << ",\n";
+	std::cout << "\t\"description\": " << json_string(describe_solution(best.indices)) << ",\n";
+	std::cout << "\t\"values\": [";
+	for (auto i = 0u; i < best.indices.size(); i++)
+		std::cout << (i ? ", " : "") << avail[best.indices[i]];
+	std::cout << "],\n";
+	if (!ac)
+		std::cout << "\t\"range\": [" << best.rg.first << ", " << best.rg.second << "],\n";
+	std::cout << "\t\"score\": " << best.score << ",\n";
+	std::cout << "\t\"generations\": " << summary.generations << ",\n";
+	std::cout << "\t\"evaluations\": " << summary.evals << ",\n";
+	std::cout << "\t\"evaluations_per_second\": " << evals_per_second << ",\n";
+	std::cout << "\t\"time\": " << summary.time << ",\n";
+	std::cout << "\t\"time_to_best\": " << summary.time_to_best << ",\n";
+	std::cout << "\t\"stop_reason\": " << json_string(summary.stop_reason) << "\n";
+	std::cout << "}" << std::endl;
 	
 	return 0;
 }
@@ -0,0 +1,330 @@
+#include "netlist.hpp"
+#include "strategy.hpp"
+#include <algorithm>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+
+netlist::netlist(std::istream &in)
+{
+	std::map<std::string, int> ids;
+	auto node = [&](const std::string &name)
+	{
+		auto [it, inserted] = ids.try_emplace(name, nodes.size());
+		if (inserted)
+			nodes.push_back(name);
+		return it->second;
+	};
+	
+	std::string line;
+	for (int number = 1; std::getline(in, line); number++)
+	{
+		line = line.substr(0, line.find('#'));
+		std::istringstream ss{line};
+		std::string name, a, b, value;
+		if (!(ss >> name))
+			continue;
+		
+		auto error = [&](const std::string &what)
+		{
+			return std::runtime_error{"netlist line " + std::to_string(number) + ": " + what};
+		};
+		
+		if (!(ss >> a >> b))
+			throw error("expected two nodes");
+		
+		if (name == ".port")
+		{
+			port_a = node(a);
+			port_b = node(b);
+		}
+		else if (name[0] == 'R' || name[0] == 'r')
+		{
+			if (a == b)
+				throw error("resistor shorted to itself");
+			
+			element e{name, node(a), node(b), 0, false};
+			if (ss >> value)
+			{
+				e.value = from_si_string(value);
+				e.fixed = true;
+			}
+			else
+			{
+				slots++;
+			}
+			
+			elements.push_back(e);
+		}
+		else
+			throw error("unknown element '" + name + "'");
+	}
+	
+	if (port_a < 0 || port_a == port_b)
+		throw std::runtime_error{"netlist has no .port with two different nodes"};
+	
+	// Floating nodes would make the conductance matrix singular
+	std::vector<bool> reached(nodes.size());
+	std::vector<int> todo{port_b};
+	reached[port_b] = true;
+	while (!todo.empty())
+	{
+		int n = todo.back();
+		todo.pop_back();
+		for (const auto &e : elements)
+			for (auto [from, to] : {std::pair{e.a, e.b}, std::pair{e.b, e.a}})
+				if (from == n && !reached[to])
+				{
+					reached[to] = true;
+					todo.push_back(to);
+				}
+	}
+	
+	for (auto i = 0u; i < nodes.size(); i++)
+		if (!reached[i])
+			throw std::runtime_error{"netlist node '" + nodes[i] + "' is not connected to the ports"};
+}
+
+std::string netlist::describe(const float *values) const
+{
+	std::stringstream ss;
+	size_t slot = 0;
+	for (const auto &e : elements)
+		ss << (&e == &elements.front() ? "" : " ") << e.name << "=" << to_si_string(e.fixed ? e.value : values[slot++]);
+	return ss.str();
+}
+
+nodal_evaluator::nodal_evaluator(const netlist &net) :
+	m_size(net.nodes.size() - 1)
+{
+	// Adjacency of the non-grounded nodes
+	std::vector<std::set<int>> adj(net.nodes.size());
+	for (const auto &e : net.elements)
+		if (e.a != net.port_b && e.b != net.port_b)
+		{
+			adj[e.a].insert(e.b);
+			adj[e.b].insert(e.a);
+		}
+	
+	// Minimum degree ordering, with the measured port last. Eliminating a node
+	// connects all of its neighbours, which is where the fill-in comes from.
+	std::vector<int> pos(net.nodes.size(), -1);
+	std::vector<std::vector<int>> pattern(m_size); //!< Positions of the off-diagonal entries of each column
+	auto eliminate = [&](int n, int k)
+	{
+		pos[n] = k;
+		for (int a : adj[n])
+		{
+			adj[a].erase(n);
+			for (int b : adj[n])
+				if (b != a)
+					adj[a].insert(b);
+		}
+	};
+	
+	std::vector<int> order;
+	for (auto k = 0u; k + 1 < m_size; k++)
+	{
+		int best = -1;
+		for (auto n = 0u; n < net.nodes.size(); n++)
+			if (pos[n] < 0 && int(n) != net.port_a && int(n) != net.port_b && (best < 0 || adj[n].size() < adj[best].size()))
+				best = n;
+		
+		order.push_back(best);
+		eliminate(best, k);
+	}
+	order.push_back(net.port_a);
+	pos[net.port_a] = m_size - 1;
+	
+	// The neighbours at the moment of elimination are the column's entries,
+	// which is recomputed here, as adj has been consumed
+	for (auto &a : adj)
+		a.clear();
+	for (const auto &e : net.elements)
+		if (e.a != net.port_b && e.b != net.port_b)
+		{
+			adj[e.a].insert(e.b);
+			adj[e.b].insert(e.a);
+		}
+	
+	for (auto k = 0u; k < m_size; k++)
+	{
+		int n = order[k];
+		for (int a : adj[n])
+			pattern[k].push_back(pos[a]);
+		std::sort(pattern[k].begin(), pattern[k].end());
+		eliminate(n, k);
+	}
+	
+	// Off-diagonal entries are stored column by column, after the pivots
+	m_columns.push_back(m_size);
+	for (const auto &col : pattern)
+		m_columns.push_back(m_columns.back() + col.size());
+	
+	auto entry = [&](int i, int j) -> std::int32_t
+	{
+		if (i == j)
+			return i;
+		if (i < j)
+			std::swap(i, j);
+		auto it = std::lower_bound(pattern[j].begin(), pattern[j].end(), i);
+		return m_columns[j] + (it - pattern[j].begin());
+	};
+	
+	// Every pair of entries in a column updates the entry in the Schur complement
+	for (auto k = 0u; k < m_size; k++)
+	{
+		m_update_start.push_back(m_updates.size());
+		const auto &col = pattern[k];
+		for (auto p = 0u; p < col.size(); p++)
+			for (auto q = p; q < col.size(); q++)
+				m_updates.push_back({std::uint32_t(entry(col[q], col[p])), m_columns[k] + p, m_columns[k] + q});
+	}
+	m_update_start.push_back(m_updates.size());
+	
+	std::int32_t slot = 0;
+	for (const auto &e : net.elements)
+	{
+		bool ga = e.a == net.port_b, gb = e.b == net.port_b;
+		m_stamps.push_back({
+			e.fixed ? -1 : slot++,
+			e.value,
+			ga ? -1 : pos[e.a],
+			gb ? -1 : pos[e.b],
+			ga || gb ? -1 : entry(pos[e.a], pos[e.b]),
+		});
+	}
+	
+	m_factor.resize(m_columns.back());
+}
+
+float nodal_evaluator::eval(const float *values)
+{
+	std::fill(m_factor.begin(), m_factor.end(), 0.0);
+	for (const auto &s : m_stamps)
+	{
+		// Shorts are just very large conductances
+		double g = 1.0 / std::max<double>(s.slot < 0 ? s.value : values[s.slot], 1e-9);
+		if (s.diag_a >= 0) m_factor[s.diag_a] += g;
+		if (s.diag_b >= 0) m_factor[s.diag_b] += g;
+		if (s.offdiag >= 0) m_factor[s.offdiag] -= g;
+	}
+	
+	double *f = m_factor.data();
+	for (auto k = 0u; k < m_size; k++)
+	{
+		double d = f[k];
+		for (auto p = m_columns[k]; p < m_columns[k + 1]; p++)
+			f[p] /= d;
+		
+		for (auto u = m_update_start[k]; u < m_update_start[k + 1]; u++)
+			f[m_updates[u].target] -= f[m_updates[u].p] * f[m_updates[u].q] * d;
+	}
+	
+	return 1.0 / f[m_size - 1];
+}
+
+/*
+	Coordinate descent from random starting points. The resistance of any
+	network is monotone in every resistor (Rayleigh's monotonicity law), so the
+	best value of a single resistor is found with binary search, just like
+	for series-parallel circuits.
+*/
+class netlist_strategy : public search_strategy
+{
+public:
+	netlist_strategy(const netlist &net, const std::vector<float> &avail, range target) :
+		m_avail(avail),
+		m_target(target),
+		m_eval(net),
+		m_values(net.size())
+	{
+		m_sol.indices.resize(net.size());
+	}
+	
+	void reset(range target) override
+	{
+		m_target = target;
+	}
+	
+	const solution &step(std::mt19937 &rng) override
+	{
+		std::uniform_int_distribution<size_t> dist(0, m_avail.size() - 1);
+		for (auto i = 0u; i < m_values.size(); i++)
+		{
+			m_sol.indices[i] = dist(rng);
+			m_values[i] = m_avail[m_sol.indices[i]];
+		}
+		
+		m_sol.evals = 0;
+		m_sol.moves = 0;
+		m_sol.score = score();
+		for (bool improved = true; improved;)
+		{
+			improved = false;
+			for (auto i = 0u; i < m_values.size(); i++)
+			{
+				auto eval = [&](size_t v)
+				{
+					m_values[i] = m_avail[v];
+					return score();
+				};
+				
+				// Binary search for the point where the score stops increasing
+				size_t a = 0, b = m_avail.size() - 1;
+				while (b - a > 2)
+				{
+					auto m = a + (b - a) / 2;
+					if (eval(m) < eval(m + 1))
+						a = m + 1;
+					else
+						b = m + 1;
+				}
+				
+				size_t best = m_sol.indices[i];
+				float best_score = m_sol.score;
+				for (auto v = a; v <= b; v++)
+				{
+					float s = eval(v);
+					if (s > best_score)
+					{
+						best = v;
+						best_score = s;
+					}
+				}
+				
+				m_values[i] = m_avail[best];
+				if (best_score > m_sol.score)
+				{
+					m_sol.indices[i] = best;
+					m_sol.score = best_score;
+					m_sol.moves++;
+					improved = true;
+				}
+			}
+		}
+		
+		float r = m_eval.eval(m_values.data());
+		m_sol.rg = {r, r};
+		return m_sol;
+	}
+
+private:
+	float score()
+	{
+		m_sol.evals++;
+		float r = m_eval.eval(m_values.data());
+		return range_score(m_target, {r, r});
+	}
+	
+	const std::vector<float> &m_avail;
+	range m_target;
+	nodal_evaluator m_eval;
+	std::vector<float> m_values;
+	solution m_sol;
+};
+
+std::unique_ptr<search_strategy> make_netlist_strategy(const netlist &net, const std::vector<float> &avail, range target)
+{
+	return std::make_unique<netlist_strategy>(net, avail, target);
+}
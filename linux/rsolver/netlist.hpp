@@ -0,0 +1,91 @@
+#pragma once
+#include <cstdint>
+#include <istream>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include "circuit.hpp"
+
+class search_strategy;
+
+/*
+	Network of resistors between arbitrary nodes, such as bridges and meshes,
+	which can't be described as series-parallel circuits. Netlists are read
+	line by line, in a format similar to SPICE:
+		
+		.port in out     terminals between which the resistance is measured
+		R1 in a          resistor between nodes `in` and `a`, with a searched value
+		R2 a out 4.7k    resistor with a fixed value
+		# comment
+	
+	Searched resistors are numbered in order of appearance, like slots.
+*/
+struct netlist
+{
+	struct element
+	{
+		std::string name;
+		int a, b;       //!< Node indices
+		float value;    //!< Only used for fixed resistors
+		bool fixed;
+	};
+	
+	explicit netlist(std::istream &in);
+	size_t size() const {return slots;}
+	std::string describe(const float *values) const;
+	
+	std::vector<element> elements;
+	std::vector<std::string> nodes;
+	int port_a = -1;
+	int port_b = -1;
+	size_t slots = 0;
+};
+
+/*
+	Nodal analysis - the resistance between the ports is found by grounding one
+	of them, injecting unit current into the other one, and solving for its
+	voltage. The conductance matrix is symmetric and positive definite, so it
+	is factorized as LDL^T. Its sparsity pattern, elimination order (minimum
+	degree) and every update of the factorization are computed once, so an
+	evaluation only stamps the conductances and runs through a flat list of
+	multiply-adds. The port is eliminated last, so its voltage is simply the
+	inverse of the last pivot and no solve is needed.
+*/
+class nodal_evaluator
+{
+public:
+	explicit nodal_evaluator(const netlist &net);
+	
+	//! Resistance between the ports
+	float eval(const float *values);
+	
+	size_t nonzeros() const {return m_factor.size();}
+
+private:
+	struct stamp
+	{
+		std::int32_t slot;     //!< -1 for fixed resistors
+		float value;
+		std::int32_t diag_a;   //!< -1 for the grounded port
+		std::int32_t diag_b;
+		std::int32_t offdiag;  //!< -1 if either node is grounded
+	};
+	
+	struct update
+	{
+		std::uint32_t target;
+		std::uint32_t p;
+		std::uint32_t q;
+	};
+	
+	size_t m_size; //!< Number of non-grounded nodes, which are the first entries of m_factor
+	std::vector<stamp> m_stamps;
+	std::vector<std::uint32_t> m_columns; //!< Start of each column's off-diagonal entries, and of its updates
+	std::vector<std::uint32_t> m_update_start;
+	std::vector<update> m_updates;
+	std::vector<double> m_factor; //!< Pivots, followed by the off-diagonal entries of L
+};
+
+//! Random-restart coordinate descent with nodal analysis
+std::unique_ptr<search_strategy> make_netlist_strategy(const netlist &net, const std::vector<float> &avail, range target);
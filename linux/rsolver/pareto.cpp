@@ -0,0 +1,176 @@
+#include "pareto.hpp"
+#include "program.hpp"
+#include "exact.hpp"
+#include <algorithm>
+#include <set>
+#include <stdexcept>
+
+pareto_archive::pareto_archive(int max_parts) :
+	m_max_parts(max_parts),
+	m_cells((max_parts + 1) * (max_parts + 1))
+{
+}
+
+float pareto_archive::bound(int parts, int distinct) const
+{
+	float error = INF;
+	for (auto p = 1; p <= std::min(parts, m_max_parts); p++)
+		for (auto d = 1; d <= std::min(distinct, p); d++)
+			error = std::min(error, cell(p, d).error);
+	return error;
+}
+
+bool pareto_archive::insert(const pareto_point &p)
+{
+	if (p.parts < 1 || p.parts > m_max_parts || p.distinct < 1 || p.distinct > p.parts)
+		throw std::runtime_error{"invalid part or value count"};
+	
+	if (p.error >= bound(p.parts, p.distinct))
+		return false;
+	
+	cell(p.parts, p.distinct) = p;
+	return true;
+}
+
+std::vector<pareto_point> pareto_archive::front() const
+{
+	// Points inserted earlier can be dominated by later ones
+	std::vector<pareto_point> front;
+	for (auto p = 1; p <= m_max_parts; p++)
+		for (auto d = 1; d <= p; d++)
+		{
+			float e = cell(p, d).error;
+			if (e < INF && e < bound(p - 1, d) && e < bound(p, d - 1))
+				front.push_back(cell(p, d));
+		}
+	
+	return front;
+}
+
+/*
+	Calls f for every partition of n elements, given as the group of every
+	element (restricted growth string) and the number of groups.
+*/
+template <typename F>
+static void for_each_partition(size_t n, F &&f)
+{
+	std::vector<size_t> groups(n, 0);
+	std::vector<size_t> prefix_max(n, 0);
+	while (true)
+	{
+		for (auto i = 1u; i < n; i++)
+			prefix_max[i] = std::max(prefix_max[i - 1], groups[i]);
+		f(groups, prefix_max.back() + 1);
+		
+		// An element can start a new group at most, the ones after it are reset
+		auto i = n - 1;
+		while (i > 0 && groups[i] > prefix_max[i - 1])
+			i--;
+		if (i == 0)
+			return;
+		
+		groups[i]++;
+		std::fill(groups.begin() + i + 1, groups.end(), 0);
+	}
+}
+
+void pareto_search(const std::string &desc, const std::vector<float> &avail, range target, pareto_archive &archive,
+	topology_solver *tsolver, int topology_id)
+{
+	// Single resistors aren't valid circuit descriptions on their own
+	auto circuit = str_to_circuit(desc == "r" ? "(r)" : desc);
+	auto prog = compile_circuit(*circuit);
+	auto res = circuit->get_resistances();
+	int parts = prog.size();
+	if (parts > pareto_max_parts)
+		throw std::runtime_error{"too many resistors for the Pareto search"};
+	if (prog.slots.size() != prog.size() || !prog.constants.empty())
+		throw std::runtime_error{"the Pareto search doesn't support fixed or matched resistors"};
+	
+	auto add = [&](const std::vector<float> &values, float score, range rg)
+	{
+		for (auto i = 0u; i < res.size(); i++)
+			*res[i] = values[i];
+		
+		int distinct = std::set<float>(values.begin(), values.end()).size();
+		archive.insert({-score, parts, distinct, rg, circuit->describe()});
+	};
+	
+	// Partitions mapped onto each other by swapping identical siblings are
+	// equivalent, so only the first one of every orbit is searched. Images are
+	// compared with their groups renumbered in order of appearance, like the
+	// partitions themselves.
+	auto renumber = [](std::vector<size_t> &groups, size_t count)
+	{
+		std::vector<size_t> number(count, count);
+		size_t next = 0;
+		for (auto &g : groups)
+		{
+			if (number[g] == count)
+				number[g] = next++;
+			g = number[g];
+		}
+	};
+	
+	std::set<std::vector<size_t>> seen;
+	std::vector<std::pair<std::vector<size_t>, size_t>> partitions;
+	for_each_partition(parts, [&](const std::vector<size_t> &groups, size_t count){
+		if (!seen.insert(groups).second)
+			return;
+		partitions.push_back({groups, count});
+		
+		std::vector<std::vector<size_t>> pending{groups};
+		while (!pending.empty())
+		{
+			auto image = std::move(pending.back());
+			pending.pop_back();
+			for (const auto &sym : prog.symmetries)
+			{
+				auto next = image;
+				std::swap_ranges(next.begin() + sym.a, next.begin() + sym.a + sym.length, next.begin() + sym.b);
+				renumber(next, count);
+				if (seen.insert(next).second)
+					pending.push_back(std::move(next));
+			}
+		}
+	});
+	
+	// Fewer groups first, so that the bounds are tight for the larger ones
+	std::stable_sort(partitions.begin(), partitions.end(), [](const auto &a, const auto &b){
+		return a.second < b.second;
+	});
+	
+	for (const auto &[groups, count] : partitions)
+	{
+		float bound = archive.bound(parts, count);
+		if (bound == 0)
+			break;
+		
+		std::vector<float> values(parts);
+		if (count == size_t(parts) && tsolver)
+		{
+			auto sol = tsolver->solve(topology_id, target, -bound);
+			if (sol.score > -bound)
+				add(sol.values, sol.score, sol.rg);
+			continue;
+		}
+		
+		// Leaves of a group share a slot. Symmetries only hold without sharing.
+		circuit_program shared = prog;
+		for (auto &s : shared.slots)
+			s = groups[s];
+		shared.tols.resize(count);
+		if (count != size_t(parts))
+			shared.symmetries.clear();
+		
+		exact_solver solver(std::move(shared), avail, target);
+		solver.best_score = -bound;
+		solver.solve([](const exact_solver &){});
+		if (solver.best_indices.empty())
+			continue;
+		
+		for (auto i = 0u; i < values.size(); i++)
+			values[i] = avail[solver.best_indices[groups[i]]];
+		add(values, solver.best_score, solver.best_range);
+	}
+}
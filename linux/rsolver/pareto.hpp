@@ -0,0 +1,53 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "circuit.hpp"
+#include "topology.hpp"
+
+constexpr int pareto_max_parts = 8;
+
+struct pareto_point
+{
+	float error = INF; //!< Negated score
+	int parts = 0;
+	int distinct = 0;  //!< Number of distinct values
+	range rg;
+	std::string desc;
+};
+
+/*
+	Archive of non-dominated solutions. Part and value counts are small
+	integers, so only the best point for every pair of them is kept, and
+	dominance checks only scan the cells with no more parts and values.
+*/
+class pareto_archive
+{
+public:
+	pareto_archive(int max_parts);
+	
+	//! Smallest error with at most that many parts and values - points have to beat it
+	float bound(int parts, int distinct) const;
+	
+	//! Returns true if the point isn't dominated
+	bool insert(const pareto_point &p);
+	
+	//! Non-dominated points, by the number of parts and values
+	std::vector<pareto_point> front() const;
+
+private:
+	pareto_point &cell(int parts, int distinct) {return m_cells[parts * (m_max_parts + 1) + distinct];}
+	const pareto_point &cell(int parts, int distinct) const {return m_cells[parts * (m_max_parts + 1) + distinct];}
+	
+	int m_max_parts;
+	std::vector<pareto_point> m_cells;
+};
+
+/*
+	Adds the best solutions of the circuit using every possible number of
+	distinct values to the archive. For every partition of the resistors into
+	groups sharing a value, the branch-and-bound search is run with one value
+	per group, looking only for solutions which aren't dominated yet. If the
+	topology solver is provided, it solves the circuit with no shared values.
+*/
+void pareto_search(const std::string &desc, const std::vector<float> &avail, range target, pareto_archive &archive,
+	topology_solver *tsolver = nullptr, int topology_id = -1);
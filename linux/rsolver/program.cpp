@@ -0,0 +1,180 @@
+#include "program.hpp"
+#include <stdexcept>
+#include <algorithm>
+
+/*
+	Both operations are commutative, so the operand needing more stack space
+	can always be evaluated first (Sethi-Ullman ordering). This keeps the stack
+	depth logarithmic even for deeply nested circuits, such as ladders.
+*/
+static void reorder_program(circuit_program &prog)
+{
+	struct node
+	{
+		opcode op;
+		std::uint32_t slot;
+		std::int32_t left, right;
+		size_t need;
+	};
+	
+	std::vector<node> nodes;
+	std::vector<std::int32_t> stack;
+	size_t leaf = 0, constant = 0;
+	for (auto op : prog.ops)
+	{
+		node n{op, 0, -1, -1, 1};
+		if (op == opcode::leaf)
+		{
+			n.slot = prog.slots[leaf++];
+		}
+		else if (op == opcode::constant)
+		{
+			n.slot = constant++;
+		}
+		else
+		{
+			n.right = stack.back();
+			stack.pop_back();
+			n.left = stack.back();
+			stack.pop_back();
+			
+			auto l = nodes[n.left].need, r = nodes[n.right].need;
+			n.need = l == r ? l + 1 : std::max(l, r);
+			if (r > l)
+				std::swap(n.left, n.right);
+		}
+		
+		stack.push_back(nodes.size());
+		nodes.push_back(n);
+	}
+	
+	auto constants = std::move(prog.constants);
+	auto constant_kinds = std::move(prog.constant_kinds);
+	prog.ops.clear();
+	prog.slots.clear();
+	prog.constants.clear();
+	prog.constant_kinds.clear();
+	
+	// Explicit stack, since nesting can be arbitrarily deep
+	std::vector<std::pair<std::int32_t, bool>> todo{{stack.back(), false}};
+	while (!todo.empty())
+	{
+		auto [i, expanded] = todo.back();
+		todo.pop_back();
+		const auto &n = nodes[i];
+		
+		if (n.op == opcode::leaf)
+		{
+			prog.ops.push_back(opcode::leaf);
+			prog.slots.push_back(n.slot);
+		}
+		else if (n.op == opcode::constant)
+		{
+			prog.ops.push_back(opcode::constant);
+			prog.constants.push_back(constants[n.slot]);
+			prog.constant_kinds.push_back(constant_kinds[n.slot]);
+		}
+		else if (expanded)
+		{
+			prog.ops.push_back(n.op);
+		}
+		else
+		{
+			todo.push_back({i, true});
+			todo.push_back({n.right, false});
+			todo.push_back({n.left, false});
+		}
+	}
+}
+
+circuit_program compile_circuit(const resistance &circuit)
+{
+	circuit_program prog;
+	circuit.compile(prog);
+	reorder_program(prog);
+	
+	size_t depth = 0;
+	for (auto op : prog.ops)
+	{
+		depth += op == opcode::leaf || op == opcode::constant ? 1 : -1;
+		prog.stack_depth = std::max(prog.stack_depth, depth);
+	}
+	
+	if (prog.stack_depth > program_max_stack)
+		throw std::runtime_error{"circuit too deeply nested"};
+	
+	return prog;
+}
+
+bool circuit_program::reactive() const
+{
+	auto is_reactive = [](leaf_kind k){return k != leaf_kind::resistor;};
+	return std::any_of(kinds.begin(), kinds.end(), is_reactive) || std::any_of(constant_kinds.begin(), constant_kinds.end(), is_reactive);
+}
+
+range circuit_program::eval(const float *values) const
+{
+	float lo[program_max_stack];
+	float hi[program_max_stack];
+	size_t sp = 0;
+	const std::uint32_t *slot = slots.data();
+	const range *constant = constants.data();
+	
+	for (auto op : ops)
+	{
+		switch (op)
+		{
+			case opcode::leaf:
+			{
+				auto s = *slot++;
+				lo[sp] = (1.f - tols[s]) * values[s];
+				hi[sp] = (1.f + tols[s]) * values[s];
+				sp++;
+				break;
+			}
+			
+			case opcode::constant:
+				lo[sp] = constant->first;
+				hi[sp] = constant->second;
+				constant++;
+				sp++;
+				break;
+			
+			case opcode::serial:
+				sp--;
+				lo[sp - 1] += lo[sp];
+				hi[sp - 1] += hi[sp];
+				break;
+			
+			case opcode::parallel:
+				sp--;
+				lo[sp - 1] = parallel2(lo[sp - 1], lo[sp]);
+				hi[sp - 1] = parallel2(hi[sp - 1], hi[sp]);
+				break;
+		}
+	}
+	
+	return {lo[0], hi[0]};
+}
+
+bool canonicalize(const circuit_program &prog, size_t *indices)
+{
+	// Swapping whole subtrees keeps their inner symmetries satisfied, so inner
+	// blocks are visited first, and outer ones are bubble-sorted until stable
+	bool swapped_any = false, swapped;
+	do
+	{
+		swapped = false;
+		for (auto it = prog.symmetries.rbegin(); it != prog.symmetries.rend(); ++it)
+		{
+			auto a = indices + it->a, b = indices + it->b;
+			if (std::lexicographical_compare(b, b + it->length, a, a + it->length))
+			{
+				std::swap_ranges(a, a + it->length, b);
+				swapped = swapped_any = true;
+			}
+		}
+	} while (swapped);
+	
+	return swapped_any;
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <limits>
+#include <algorithm>
+#include "circuit.hpp"
+
+enum class opcode : std::uint8_t
+{
+	leaf,     //!< Push value of the next leaf
+	constant, //!< Push the next constant
+	serial,   //!< Pop two values, push their sum
+	parallel, //!< Pop two values, push their parallel combination
+};
+
+constexpr size_t program_max_stack = 64;
+
+/*
+	Leaves [a, a + length) and [b, b + length) belong to identical sibling
+	subtrees, so the values of the first ones can be kept lexicographically
+	not greater than the values of the second ones.
+*/
+struct slot_symmetry
+{
+	std::uint32_t a;
+	std::uint32_t b;
+	std::uint32_t length;
+};
+
+/*
+	Circuit lowered into a flat postfix program. Slots are numbered in the
+	same order as returned by resistance::get_resistances(). Matched resistors
+	share a slot, and fixed ones are constants. Programs with capacitors or
+	inductors can only be evaluated with impedance_evaluator.
+*/
+struct circuit_program
+{
+	range eval(const float *values) const;
+	size_t size() const {return tols.size();}
+	bool reactive() const;
+	
+	std::vector<opcode> ops;
+	std::vector<std::uint32_t> slots; //!< Value slot of each leaf, in order of appearance
+	std::vector<float> tols;          //!< Tolerance of each slot
+	std::vector<range> constants;     //!< Ranges of the fixed resistors, in order of appearance
+	std::vector<leaf_kind> kinds;     //!< Kind of each slot
+	std::vector<leaf_kind> constant_kinds;
+	std::vector<slot_symmetry> symmetries; //!< Outer blocks first
+	size_t stack_depth = 0;
+};
+
+circuit_program compile_circuit(const resistance &circuit);
+
+/*
+	Brings the solution to the canonical form, by swapping values of identical
+	sibling subtrees until all symmetries are satisfied. The circuit is not
+	changed by this. Returns true if any values were swapped.
+*/
+bool canonicalize(const circuit_program &prog, size_t *indices);
+
+// Branch-free, so it can be vectorized. Both values are non-negative - if
+// their sum is zero, so is their product.
+inline float parallel2(float a, float b)
+{
+	return a * b / std::max(a + b, std::numeric_limits<float>::min());
+}
@@ -0,0 +1,478 @@
+#include "search.hpp"
+#include "strategy.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+size_t neighbour_values(const incremental_circuit &circ, const std::vector<float> &avail, range target, size_t slot, size_t current, size_t *out)
+{
+	size_t cand[max_neighbour_values];
+	size_t n = 0;
+	if (current != 0) cand[n++] = current - 1;
+	if (current != avail.size() - 1) cand[n++] = current + 1;
+	
+	// Values nearest to those making either bound of the range hit the target
+	for (auto upper : {false, true})
+	{
+		float v = circ.solve_leaf(slot, upper ? target.second : target.first, upper);
+		size_t pos = std::lower_bound(avail.begin(), avail.end(), v) - avail.begin();
+		if (pos > 0) cand[n++] = pos - 1;
+		if (pos < avail.size()) cand[n++] = pos;
+	}
+	
+	size_t count = 0;
+	for (auto j = 0u; j < n; j++)
+		if (cand[j] != current && std::find(cand, cand + j, cand[j]) == cand + j)
+			out[count++] = cand[j];
+	return count;
+}
+
+local_search::local_search(const circuit_program &prog, const std::vector<float> &avail, range target) :
+	m_prog(prog),
+	m_avail(avail),
+	m_target(target),
+	m_circ(prog),
+	m_values(prog.size()),
+	m_kernel(get_batch_kernel(prog))
+{
+	m_sol.indices.resize(prog.size());
+	
+	// Evaluating the whole neighbourhood in batches is preferred whenever it is
+	// estimated to be cheaper than probing every change incrementally
+	size_t probe_cost = 0;
+	for (auto i = 0u; i < prog.size(); i++)
+		probe_cost += 4 * m_circ.path_length(i);
+	size_t batch_cost = prog.ops.size() * ((4 * prog.size() + batch_lanes - 1) / batch_lanes);
+	m_use_batch = batch_cost < probe_cost;
+	
+	// Neighbourhoods never have more than 4 changes per resistor
+	m_changes.reserve(4 * prog.size());
+	if (m_use_batch)
+		m_batch_values.resize(prog.size() * batch_lanes);
+	
+	// Warm up the scratch space of the incremental circuit
+	m_circ.set(m_values.data());
+	for (auto i = 0u; i < prog.size(); i++)
+		m_circ.solve_leaf(i, 0, false);
+}
+
+void local_search::start(const size_t *indices)
+{
+	std::copy_n(indices, m_sol.indices.size(), m_sol.indices.begin());
+	for (auto i = 0u; i < m_values.size(); i++)
+		m_values[i] = m_avail[indices[i]];
+	m_circ.set(m_values.data());
+	m_sol.rg = m_circ.get();
+	m_sol.score = range_score(m_target, m_sol.rg);
+	m_sol.evals = 1;
+	m_sol.moves = 0;
+}
+
+const solution &local_search::hill_climb(const size_t *start_indices)
+{
+	start(start_indices);
+	auto &indices = m_sol.indices;
+	const auto &avail = m_avail;
+	auto target = m_target;
+	
+	alignas(64) float lo[batch_lanes];
+	alignas(64) float hi[batch_lanes];
+	
+	while (true)
+	{
+		m_changes.clear();
+		for (auto i = 0u; i < indices.size(); i++)
+		{
+			size_t cand[max_neighbour_values];
+			auto n = neighbour_values(m_circ, avail, target, i, indices[i], cand);
+			for (auto j = 0u; j < n; j++)
+				m_changes.push_back({i, cand[j], {0, 0}});
+		}
+		
+		// Circuits made only of fixed parts have no neighbours
+		if (m_changes.empty())
+			break;
+		
+		if (m_use_batch)
+		{
+			for (auto i = 0u; i < m_values.size(); i++)
+				std::fill_n(&m_batch_values[i * batch_lanes], batch_lanes, m_values[i]);
+			
+			for (auto b = 0u; b < m_changes.size(); b += batch_lanes)
+			{
+				auto n = std::min(batch_lanes, m_changes.size() - b);
+				for (auto l = 0u; l < n; l++)
+					m_batch_values[m_changes[b + l].res_id * batch_lanes + l] = avail[m_changes[b + l].val_id];
+				
+				m_kernel.eval(m_prog, m_batch_values.data(), lo, hi);
+				
+				for (auto l = 0u; l < n; l++)
+				{
+					m_changes[b + l].rg = {lo[l], hi[l]};
+					m_batch_values[m_changes[b + l].res_id * batch_lanes + l] = m_values[m_changes[b + l].res_id];
+				}
+			}
+		}
+		else
+		{
+			// Only the path from the changed resistor to the root is re-evaluated
+			for (auto &chg : m_changes)
+				chg.rg = m_circ.probe(chg.res_id, avail[chg.val_id]);
+		}
+		
+		m_sol.evals += m_changes.size();
+		auto &best = *std::max_element(m_changes.begin(), m_changes.end(), [&target](const auto &lhs, const auto &rhs){
+			return range_score(target, lhs.rg) < range_score(target, rhs.rg);
+		});
+		
+		if (range_score(target, best.rg) <= m_sol.score)
+			break;
+		
+		indices[best.res_id] = best.val_id;
+		m_values[best.res_id] = avail[best.val_id];
+		m_circ.commit(best.res_id, avail[best.val_id]);
+		
+		// Rounding in the batch kernels may differ from the incremental evaluation slightly,
+		// so the score is taken from the same evaluation the neighbours are compared with
+		m_sol.rg = best.rg;
+		m_sol.score = range_score(target, best.rg);
+		m_sol.moves++;
+	}
+	
+	canonicalize(m_prog, m_sol.indices.data());
+	return m_sol;
+}
+/*
+	Finds the best value of a single resistor, with all others fixed. Both bounds
+	of the range are monotone in the value, so the score can only peak between
+	the values making the lower and the upper bound hit the target. That interval
+	is located with binary search, and the peak inside it as well.
+*/
+static size_t best_coordinate(const incremental_circuit &circ, const std::vector<float> &avail, range target, size_t slot, float &score, size_t &evals)
+{
+	auto find = [&](bool upper)
+	{
+		float v = circ.solve_leaf(slot, upper ? target.second : target.first, upper);
+		return size_t(std::lower_bound(avail.begin(), avail.end(), v) - avail.begin());
+	};
+	
+	auto eval = [&](size_t i)
+	{
+		evals++;
+		return range_score(target, circ.probe(slot, avail[i]));
+	};
+	
+	size_t a = find(false), b = find(true);
+	if (a > b) std::swap(a, b);
+	a = a > 0 ? a - 1 : 0;
+	b = std::min(b, avail.size() - 1);
+	
+	// Binary search for the point where the score stops increasing
+	while (b - a > 2)
+	{
+		auto m = a + (b - a) / 2;
+		if (eval(m) < eval(m + 1))
+			a = m + 1;
+		else
+			b = m + 1;
+	}
+	
+	size_t best = a;
+	score = eval(a);
+	for (auto i = a + 1; i <= b; i++)
+	{
+		float s = eval(i);
+		if (s > score)
+		{
+			score = s;
+			best = i;
+		}
+	}
+	
+	return best;
+}
+
+const solution &local_search::coordinate_descent(const size_t *start_indices)
+{
+	start(start_indices);
+	for (bool improved = true; improved;)
+	{
+		improved = false;
+		for (auto i = 0u; i < m_sol.indices.size(); i++)
+		{
+			float score;
+			auto best = best_coordinate(m_circ, m_avail, m_target, i, score, m_sol.evals);
+			if (score > m_sol.score)
+			{
+				m_sol.indices[i] = best;
+				m_circ.commit(i, m_avail[best]);
+				m_sol.score = score;
+				m_sol.moves++;
+				improved = true;
+			}
+		}
+	}
+	
+	m_sol.rg = m_circ.get();
+	canonicalize(m_prog, m_sol.indices.data());
+	return m_sol;
+}
+
+solution hill_climb(const circuit_program &prog, const std::vector<float> &avail, range target, const std::vector<size_t> &indices)
+{
+	return local_search(prog, avail, target).hill_climb(indices.data());
+}
+
+solution coordinate_descent(const circuit_program &prog, const std::vector<float> &avail, range target, const std::vector<size_t> &indices)
+{
+	return local_search(prog, avail, target).coordinate_descent(indices.data());
+}
+
+/*
+	Scores of solutions which have already been rescored. The table has a fixed
+	number of entries, allocated on first use, and colliding solutions simply
+	replace each other - so the search loop never allocates, at the cost of
+	rescoring some solutions again.
+*/
+class rescore_cache
+{
+public:
+	template <typename F>
+	float get(const std::vector<size_t> &indices, F &&rescore)
+	{
+		size_t n = indices.size();
+		if (m_scores.empty())
+		{
+			m_indices.resize(entries * n);
+			m_scores.resize(entries);
+			m_used.resize(entries);
+		}
+		
+		std::uint64_t h = 14695981039346656037ull;
+		for (auto i : indices)
+			h = (h ^ i) * 1099511628211ull;
+		
+		auto e = h & (entries - 1);
+		auto stored = &m_indices[e * n];
+		if (!m_used[e] || !std::equal(indices.begin(), indices.end(), stored))
+		{
+			std::copy(indices.begin(), indices.end(), stored);
+			m_scores[e] = rescore();
+			m_used[e] = true;
+		}
+		
+		return m_scores[e];
+	}
+
+private:
+	static constexpr size_t entries = 4096; //!< Power of two
+	std::vector<size_t> m_indices;
+	std::vector<float> m_scores;
+	std::vector<bool> m_used;
+};
+
+search_summary restart_search(const circuit_program &prog, const std::vector<float> &avail, range target, const search_config &cfg,
+	const std::function<void(const search_report&)> &on_improvement)
+{
+	return restart_search([&]{return make_strategy(cfg.strategy, prog, avail, target);}, cfg, on_improvement);
+}
+
+search_summary restart_search(const strategy_factory &make, const search_config &cfg,
+	const std::function<void(const search_report&)> &on_improvement)
+{
+	using clock = std::chrono::steady_clock;
+	auto start = clock::now();
+	auto elapsed = [&start]{return std::chrono::duration<double>(clock::now() - start).count();};
+	
+	std::atomic<float> best_score{-INF};
+	std::atomic<size_t> total_evals{0};
+	std::atomic<size_t> total_generations{0};
+	std::atomic<size_t> best_generation{0};
+	std::atomic<size_t> total_moves{0};
+	std::atomic<float> current_score{-INF};
+	std::atomic<bool> stop{false};
+	std::mutex queue_mutex;
+	std::condition_variable queue_cv;
+	std::condition_variable sample_cv;
+	std::deque<search_report> queue;
+	std::string stop_reason;
+	
+	// Workers count on their own, the shared totals are only kept when something reads them
+	bool share_evals = cfg.on_sample || cfg.max_evals;
+	bool share_generations = cfg.on_sample || cfg.stall_generations;
+	struct worker_totals
+	{
+		size_t evals = 0;
+		size_t generations = 0;
+	};
+	std::vector<worker_totals> totals(cfg.threads);
+	
+	// The first reason to stop wins
+	auto request_stop = [&](const char *reason)
+	{
+		std::lock_guard lock{queue_mutex};
+		if (!stop.exchange(true))
+			stop_reason = reason;
+		queue_cv.notify_one();
+		sample_cv.notify_all();
+	};
+	
+	auto worker = [&](unsigned thread_id)
+	{
+		std::seed_seq seq{cfg.seed, static_cast<std::uint64_t>(thread_id)};
+		std::mt19937 rng{seq};
+		rescore_cache rescored;
+		
+		// All buffers are allocated up front - the solution is only copied when reported
+		auto strategy = make();
+		
+		size_t evals = 0;
+		int generation = 0;
+		for (; !stop.load(std::memory_order_relaxed); generation++)
+		{
+			const auto &sol = strategy->step(rng);
+			
+			float score = sol.score;
+			if (cfg.rescore)
+				score = rescored.get(sol.indices, [&]{return cfg.rescore(sol);});
+			
+			evals += sol.evals;
+			size_t shared_evals = share_evals ? total_evals += sol.evals : 0;
+			size_t shared_generations = share_generations ? ++total_generations : 0;
+			if (cfg.on_sample)
+			{
+				total_moves.fetch_add(sol.moves, std::memory_order_relaxed);
+				current_score.store(score, std::memory_order_relaxed);
+			}
+			
+			// Publish only if the shared best score has actually been improved
+			float best = best_score.load(std::memory_order_relaxed);
+			while (score > best)
+			{
+				if (best_score.compare_exchange_weak(best, score))
+				{
+					best_generation = shared_generations;
+					if (score >= cfg.stop_score)
+						request_stop("optimal solution found");
+					
+					std::lock_guard lock{queue_mutex};
+					queue.push_back({sol, thread_id, generation, elapsed()});
+					queue.back().sol.score = score;
+					queue_cv.notify_one();
+					break;
+				}
+			}
+			
+			if (cfg.max_evals && shared_evals >= cfg.max_evals)
+				request_stop("evaluation limit reached");
+			size_t since_best = shared_generations - std::min<size_t>(shared_generations, best_generation);
+			if (cfg.stall_generations && since_best >= cfg.stall_generations)
+				request_stop("no improvement in the last generations");
+		}
+		
+		totals[thread_id] = {evals, static_cast<size_t>(generation)};
+	};
+	
+	std::vector<std::thread> threads;
+	for (auto i = 0u; i < cfg.threads; i++)
+		threads.emplace_back(worker, i);
+	
+	// Samples only read the counters, so the workers never wait for the sampler
+	telemetry_sample last_sample{};
+	auto take_sample = [&]
+	{
+		telemetry_sample s;
+		s.time = elapsed();
+		s.evals = total_evals.load(std::memory_order_relaxed);
+		s.generations = total_generations.load(std::memory_order_relaxed);
+		s.moves = total_moves.load(std::memory_order_relaxed);
+		s.current_score = current_score.load(std::memory_order_relaxed);
+		s.best_score = best_score.load(std::memory_order_relaxed);
+		double dt = std::max(s.time - last_sample.time, 1e-9);
+		s.evals_per_second = (s.evals - last_sample.evals) / dt;
+		s.moves_per_second = (s.moves - last_sample.moves) / dt;
+		cfg.on_sample(s);
+		last_sample = s;
+	};
+	
+	std::thread sampler;
+	if (cfg.on_sample)
+		sampler = std::thread([&]{
+			auto interval = std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(cfg.sample_interval));
+			for (auto next = start + interval;; next += interval)
+			{
+				{
+					std::unique_lock lock{queue_mutex};
+					if (sample_cv.wait_until(lock, next, [&]{return stop.load();}))
+						return;
+				}
+				
+				take_sample();
+			}
+		});
+	
+	auto deadline = start + std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(cfg.time_limit));
+	
+	// Reports can be enqueued out of order, hence the additional check
+	search_summary summary;
+	auto deliver = [&](const search_report &report)
+	{
+		if (report.sol.score > summary.best.score)
+		{
+			summary.best = report.sol;
+			summary.time_to_best = report.time;
+			on_improvement(report);
+		}
+	};
+	
+	auto ready = [&]{return !queue.empty() || stop;};
+	while (true)
+	{
+		std::unique_lock lock{queue_mutex};
+		if (cfg.time_limit > 0)
+		{
+			if (!queue_cv.wait_until(lock, deadline, ready))
+			{
+				lock.unlock();
+				request_stop("time limit reached");
+				continue;
+			}
+		}
+		else
+			queue_cv.wait(lock, ready);
+		
+		if (queue.empty())
+			break;
+		
+		auto report = std::move(queue.front());
+		queue.pop_front();
+		lock.unlock();
+		deliver(report);
+	}
+	
+	// Improvements found by the threads while stopping
+	for (auto &t : threads)
+		t.join();
+	for (auto &report : queue)
+		deliver(report);
+	
+	if (sampler.joinable())
+	{
+		sampler.join();
+		take_sample();
+	}
+	
+	for (const auto &t : totals)
+	{
+		summary.evals += t.evals;
+		summary.generations += t.generations;
+	}
+	summary.time = elapsed();
+	summary.stop_reason = stop_reason;
+	return summary;
+}
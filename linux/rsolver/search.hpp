@@ -0,0 +1,157 @@
+#pragma once
+#include <vector>
+#include <random>
+#include <functional>
+#include <memory>
+#include <cstdint>
+#include <string>
+#include "circuit.hpp"
+#include "program.hpp"
+#include "incremental.hpp"
+#include "batch.hpp"
+
+class search_strategy;
+
+struct solution
+{
+	std::vector<size_t> indices;
+	range rg;
+	float score = -INF;
+	size_t evals = 0; //!< Number of circuit evaluations it took to find
+	size_t moves = 0; //!< Number of accepted moves it took to find
+};
+
+/*
+	Progress of the search at a point in time. Counters are only updated once
+	per generation, so that the workers' loops aren't slowed down.
+*/
+struct telemetry_sample
+{
+	double time; //!< Seconds since the start of the search
+	size_t evals;
+	size_t generations;
+	size_t moves;
+	float current_score;     //!< Of the latest generation, on any thread
+	float best_score;
+	double evals_per_second; //!< Since the previous sample
+	double moves_per_second;
+};
+
+struct search_config
+{
+	unsigned threads = 1;
+	std::uint64_t seed = 0;
+	std::string strategy = "descent"; //!< See get_strategy_names()
+	
+	//! Optional replacement for the score of every local optimum found
+	std::function<float(const solution&)> rescore;
+	
+	float stop_score = 0; //!< Score which can't be improved on, ends the search
+	
+	// Other stopping criteria - zero means no limit
+	double time_limit = 0;        //!< In seconds
+	size_t max_evals = 0;
+	size_t stall_generations = 0; //!< Generations without improvement
+	
+	//! Optional telemetry, sampled on a separate thread, and once more at the end
+	std::function<void(const telemetry_sample&)> on_sample;
+	double sample_interval = 0.1; //!< In seconds
+};
+
+struct search_report
+{
+	solution sol;
+	unsigned thread;
+	int generation;
+	double time; //!< Seconds since the start of the search
+};
+
+struct search_summary
+{
+	solution best;
+	size_t evals = 0;
+	size_t generations = 0;
+	double time = 0;
+	double time_to_best = 0;
+	std::string stop_reason;
+};
+
+constexpr size_t max_neighbour_values = 6;
+
+/*
+	Candidate values of a single resistor - one position up and down in the
+	available values, and the values nearest to the ones making either bound of
+	the range hit the target. Writes distinct indices other than the current one
+	to out, and returns their number.
+*/
+size_t neighbour_values(const incremental_circuit &circ, const std::vector<float> &avail, range target, size_t slot, size_t current, size_t *out);
+
+/*
+	State of the local searches, with all buffers allocated once, so that
+	restarts don't allocate memory. The returned solution is in canonical form
+	(see canonicalize()), and only valid until the next search.
+*/
+class local_search
+{
+public:
+	local_search(const circuit_program &prog, const std::vector<float> &avail, range target);
+	
+	/*
+		Steepest ascent hill climbing, starting from the provided solution.
+		Each step changes a single resistor - either by one position in the available
+		values, or straight to the values nearest to the ones hitting the target.
+	*/
+	const solution &hill_climb(const size_t *indices);
+	
+	/*
+		Coordinate descent, starting from the provided solution. Every sweep sets each
+		resistor in turn to its best value, with all others fixed, until a sweep
+		brings no improvement.
+	*/
+	const solution &coordinate_descent(const size_t *indices);
+	
+	void set_target(range target) {m_target = target;}
+
+private:
+	struct res_change
+	{
+		size_t res_id;
+		size_t val_id;
+		range rg;
+	};
+	
+	void start(const size_t *indices);
+	
+	const circuit_program &m_prog;
+	const std::vector<float> &m_avail;
+	range m_target;
+	incremental_circuit m_circ;
+	std::vector<float> m_values;
+	batch_kernel m_kernel;
+	bool m_use_batch;
+	std::vector<res_change> m_changes;
+	std::vector<float> m_batch_values; //!< Neighbourhood, batch_lanes values per slot
+	solution m_sol;
+};
+
+solution hill_climb(const circuit_program &prog, const std::vector<float> &avail, range target, const std::vector<size_t> &indices);
+solution coordinate_descent(const circuit_program &prog, const std::vector<float> &avail, range target, const std::vector<size_t> &indices);
+
+/*
+	Runs the search strategy (random-restart coordinate descent by default) on
+	cfg.threads threads, each one with its own RNG stream seeded from cfg.seed
+	and the thread number. Improvements
+	of the shared best score are reported through the callback, which is always
+	invoked on the calling thread. If cfg.rescore is set, it's invoked on the
+	worker threads and results are cached, as restarts often end up in the same
+	local optima. The search runs until one of the stopping criteria in cfg is
+	met - possibly never.
+*/
+search_summary restart_search(const circuit_program &prog, const std::vector<float> &avail, range target, const search_config &cfg,
+	const std::function<void(const search_report&)> &on_improvement);
+
+using strategy_factory = std::function<std::unique_ptr<search_strategy>()>;
+
+//! Same as above, but with strategies created by the factory, on the worker threads
+search_summary restart_search(const strategy_factory &make, const search_config &cfg,
+	const std::function<void(const search_report&)> &on_improvement);
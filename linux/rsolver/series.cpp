@@ -0,0 +1,54 @@
+#include "series.hpp"
+#include <cmath>
+#include <stdexcept>
+
+std::vector<float> get_eseries(const std::string &name)
+{
+	// E24 and the series derived from it don't follow the formula
+	static const std::vector<float> e24{
+		1.0, 1.1, 1.2, 1.3, 1.5, 1.6, 1.8, 2.0, 2.2, 2.4, 2.7, 3.0,
+		3.3, 3.6, 3.9, 4.3, 4.7, 5.1, 5.6, 6.2, 6.8, 7.5, 8.2, 9.1,
+	};
+	
+	int n = 0;
+	if (name.size() > 1 && (name[0] == 'E' || name[0] == 'e'))
+		n = std::stoi(name.substr(1));
+	
+	std::vector<float> values;
+	switch (n)
+	{
+		case 6:
+		case 12:
+		case 24:
+			for (auto i = 0u; i < e24.size(); i += 24 / n)
+				values.push_back(e24[i]);
+			break;
+		
+		case 48:
+		case 96:
+		case 192:
+			for (int i = 0; i < n; i++)
+				values.push_back(std::round(std::pow(10.0, double(i) / n) * 100) / 100);
+			
+			// The only exception in E192
+			if (n == 192)
+				values[185] = 9.20f;
+			break;
+		
+		default:
+			throw std::runtime_error{"invalid E-series '" + name + "'"};
+	}
+	
+	return values;
+}
+
+std::vector<float> make_eseries_values(const std::string &name, int first, int last)
+{
+	auto base = get_eseries(name);
+	std::vector<float> values;
+	for (int d = first; d <= last; d++)
+		for (auto r : base)
+			values.push_back(r * std::pow(10.0, d));
+	
+	return values;
+}
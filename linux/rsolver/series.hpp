@@ -0,0 +1,14 @@
+#pragma once
+#include <string>
+#include <vector>
+
+/*
+	Returns values of the E-series (E6, E12, E24, E48, E96 or E192) in a single
+	decade, starting at 1.
+*/
+std::vector<float> get_eseries(const std::string &name);
+
+/*
+	Returns values of the series in decades from 10^first to 10^last
+*/
+std::vector<float> make_eseries_values(const std::string &name, int first, int last);
@@ -0,0 +1,76 @@
+#include "specialized.hpp"
+#include <memory>
+
+// Circuits used all the time get their own kernels
+static constexpr char circuit_rr_p[] = "[rr]";
+static constexpr char circuit_rr_s[] = "(rr)";
+static constexpr char circuit_r_rr[] = "(r[rr])";
+static constexpr char circuit_r_rr_rr[] = "(r[rr][rr])";
+static constexpr char circuit_r_rr_rr_r[] = "(r[rr][rr]r)";
+static constexpr char circuit_r_rrr_rr[] = "(r[rrr][rr])";
+
+template <const char *S>
+static void eval_generic(const circuit_program &prog, const float *values, float *lo, float *hi)
+{
+	specialized::eval_batch<S>(prog, values, lo, hi);
+}
+
+template <const char *S>
+[[gnu::target("avx2,fma")]]
+static void eval_avx2(const circuit_program &prog, const float *values, float *lo, float *hi)
+{
+	specialized::eval_batch<S>(prog, values, lo, hi);
+}
+
+template <const char *S>
+[[gnu::target("avx512f")]]
+static void eval_avx512(const circuit_program &prog, const float *values, float *lo, float *hi)
+{
+	specialized::eval_batch<S>(prog, values, lo, hi);
+}
+
+template <const char *S>
+static specialized_kernel make_kernel()
+{
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512f"))
+		return {S, {"specialized-avx512", eval_avx512<S>}};
+	if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+		return {S, {"specialized-avx2", eval_avx2<S>}};
+	return {S, {"specialized-generic", eval_generic<S>}};
+}
+
+const std::vector<specialized_kernel> &get_specialized_kernels()
+{
+	static const std::vector<specialized_kernel> kernels{
+		make_kernel<circuit_rr_p>(),
+		make_kernel<circuit_rr_s>(),
+		make_kernel<circuit_r_rr>(),
+		make_kernel<circuit_r_rr_rr>(),
+		make_kernel<circuit_r_rr_rr_r>(),
+		make_kernel<circuit_r_rrr_rr>(),
+	};
+	return kernels;
+}
+
+/*
+	The programs are compared rather than the descriptions, so that any
+	description of the same circuit matches. Tolerances are read by the
+	kernels at runtime, so they don't need to match.
+*/
+const batch_kernel *find_specialized_kernel(const circuit_program &prog)
+{
+	static const auto programs = []{
+		std::vector<circuit_program> v;
+		for (const auto &k : get_specialized_kernels())
+			v.push_back(compile_circuit(*str_to_circuit(k.circuit)));
+		return v;
+	}();
+	
+	const auto &kernels = get_specialized_kernels();
+	for (auto i = 0u; i < kernels.size(); i++)
+		if (programs[i].ops == prog.ops && programs[i].slots == prog.slots)
+			return &kernels[i].kernel;
+	
+	return nullptr;
+}
@@ -0,0 +1,178 @@
+#pragma once
+#include <cstddef>
+#include "program.hpp"
+#include "batch.hpp"
+
+/*
+	Evaluators specialized at compile time for a few common circuits. The
+	circuit description is parsed by the compiler into an expression type,
+	which evaluates one lane with everything inlined - there is no interpreter
+	loop or evaluation stack left, and the lane loop is vectorized. N-ary blocks
+	are split in the same way as by compile_circuit(), so the results are the
+	same as with the generic kernels.
+*/
+namespace specialized
+{
+	constexpr bool is_leaf(char c)
+	{
+		return c == 'r' || c == 'R';
+	}
+	
+	constexpr bool is_open(char c)
+	{
+		return c == '(' || c == '[';
+	}
+	
+	constexpr bool is_close(char c)
+	{
+		return c == ')' || c == ']';
+	}
+	
+	//! Number of leaves before the position, which is the slot of the leaf there
+	constexpr size_t leaves_before(const char *s, size_t pos)
+	{
+		size_t n = 0;
+		for (size_t i = 0; i < pos; i++)
+			n += is_leaf(s[i]);
+		return n;
+	}
+	
+	//! Position just after the node starting at pos
+	constexpr size_t node_end(const char *s, size_t pos)
+	{
+		if (is_leaf(s[pos]))
+			return pos + 1;
+		
+		size_t depth = 0;
+		do
+		{
+			depth += is_open(s[pos]);
+			depth -= is_close(s[pos]);
+			pos++;
+		} while (depth);
+		
+		return pos;
+	}
+	
+	constexpr size_t children_count(const char *s, size_t pos)
+	{
+		size_t n = 0;
+		for (pos++; !is_close(s[pos]); pos = node_end(s, pos))
+			n++;
+		return n;
+	}
+	
+	constexpr size_t child_pos(const char *s, size_t pos, size_t index)
+	{
+		pos++;
+		while (index--)
+			pos = node_end(s, pos);
+		return pos;
+	}
+	
+	/*
+		Expressions evaluate the lower or upper bound of one lane, depending on the
+		scales (1 - tol or 1 + tol) passed for each slot. Values of the lane are
+		W floats apart.
+	*/
+	template <size_t Slot>
+	struct leaf
+	{
+		template <size_t W>
+		[[gnu::always_inline]] static float eval(const float *scales, const float *values)
+		{
+			return scales[Slot] * values[Slot * W];
+		}
+	};
+	
+	template <opcode Op, typename L, typename R>
+	struct binary
+	{
+		template <size_t W>
+		[[gnu::always_inline]] static float eval(const float *scales, const float *values)
+		{
+			float a = L::template eval<W>(scales, values);
+			float b = R::template eval<W>(scales, values);
+			return Op == opcode::serial ? a + b : parallel2(a, b);
+		}
+	};
+	
+	template <const char *S, size_t Pos, char C = S[Pos]>
+	struct parse;
+	
+	// Children [Begin, End) of the block at Pos, as a balanced tree
+	template <const char *S, size_t Pos, opcode Op, size_t Begin, size_t End, bool Single = End - Begin == 1>
+	struct parse_children
+	{
+		using type = typename parse<S, child_pos(S, Pos, Begin)>::type;
+	};
+	
+	template <const char *S, size_t Pos, opcode Op, size_t Begin, size_t End>
+	struct parse_children<S, Pos, Op, Begin, End, false>
+	{
+		static constexpr size_t mid = Begin + (End - Begin) / 2;
+		using type = binary<Op, typename parse_children<S, Pos, Op, Begin, mid>::type, typename parse_children<S, Pos, Op, mid, End>::type>;
+	};
+	
+	template <const char *S, size_t Pos>
+	struct parse<S, Pos, 'r'>
+	{
+		using type = leaf<leaves_before(S, Pos)>;
+	};
+	
+	template <const char *S, size_t Pos>
+	struct parse<S, Pos, 'R'> : parse<S, Pos, 'r'>
+	{
+	};
+	
+	template <const char *S, size_t Pos>
+	struct parse<S, Pos, '('>
+	{
+		using type = typename parse_children<S, Pos, opcode::serial, 0, children_count(S, Pos)>::type;
+	};
+	
+	template <const char *S, size_t Pos>
+	struct parse<S, Pos, '['>
+	{
+		using type = typename parse_children<S, Pos, opcode::parallel, 0, children_count(S, Pos)>::type;
+	};
+	
+	template <const char *S>
+	struct circuit
+	{
+		using type = typename parse<S, 0>::type;
+		static constexpr size_t size = leaves_before(S, node_end(S, 0));
+	};
+	
+	template <const char *S>
+	[[gnu::always_inline]] inline void eval_batch(const circuit_program &prog, const float *values, float *lo, float *hi)
+	{
+		using expr = typename circuit<S>::type;
+		constexpr size_t n = circuit<S>::size;
+		
+		float lo_scales[n], hi_scales[n];
+		for (size_t s = 0; s < n; s++)
+		{
+			lo_scales[s] = 1.f - prog.tols[s];
+			hi_scales[s] = 1.f + prog.tols[s];
+		}
+		
+		for (size_t l = 0; l < batch_lanes; l++)
+		{
+			lo[l] = expr::template eval<batch_lanes>(lo_scales, values + l);
+			hi[l] = expr::template eval<batch_lanes>(hi_scales, values + l);
+		}
+	}
+}
+
+struct specialized_kernel
+{
+	const char *circuit;
+	batch_kernel kernel; //!< For the widest supported instruction set
+};
+
+//! All built-in specialized kernels
+const std::vector<specialized_kernel> &get_specialized_kernels();
+
+//! Specialized kernel for the circuit, or nullptr if it isn't one of the built-in ones
+const batch_kernel *find_specialized_kernel(const circuit_program &prog);
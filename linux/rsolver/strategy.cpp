@@ -0,0 +1,395 @@
+#include "strategy.hpp"
+#include "incremental.hpp"
+#include "batch.hpp"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <stdexcept>
+
+/*
+	Random-restart local search - coordinate descent or steepest ascent
+*/
+class restart_strategy : public search_strategy
+{
+public:
+	restart_strategy(const circuit_program &prog, const std::vector<float> &avail, range target, bool steepest) :
+		m_avail(avail),
+		m_search(prog, avail, target),
+		m_start(prog.size()),
+		m_steepest(steepest)
+	{
+	}
+	
+	void reset(range target) override
+	{
+		m_search.set_target(target);
+	}
+	
+	const solution &step(std::mt19937 &rng) override
+	{
+		std::uniform_int_distribution<size_t> dist(0, m_avail.size() - 1);
+		for (auto &i : m_start)
+			i = dist(rng);
+		
+		return m_steepest ? m_search.hill_climb(m_start.data()) : m_search.coordinate_descent(m_start.data());
+	}
+
+private:
+	const std::vector<float> &m_avail;
+	local_search m_search;
+	std::vector<size_t> m_start;
+	bool m_steepest;
+};
+
+/*
+	Common part of the strategies walking through single-resistor changes
+	with the incremental evaluator
+*/
+class walk_strategy : public search_strategy
+{
+public:
+	walk_strategy(const circuit_program &prog, const std::vector<float> &avail, range target) :
+		m_prog(prog),
+		m_avail(avail),
+		m_target(target),
+		m_circ(prog),
+		m_values(prog.size())
+	{
+		m_current.resize(prog.size());
+		m_best.indices.resize(prog.size());
+	}
+	
+	void reset(range target) override
+	{
+		m_target = target;
+	}
+
+protected:
+	float random_start(std::mt19937 &rng)
+	{
+		std::uniform_int_distribution<size_t> dist(0, m_avail.size() - 1);
+		for (auto i = 0u; i < m_current.size(); i++)
+		{
+			m_current[i] = dist(rng);
+			m_values[i] = m_avail[m_current[i]];
+		}
+		
+		m_circ.set(m_values.data());
+		m_best.rg = m_circ.get();
+		m_best.score = range_score(m_target, m_best.rg);
+		m_best.evals = 1;
+		m_best.moves = 0;
+		std::copy(m_current.begin(), m_current.end(), m_best.indices.begin());
+		return m_best.score;
+	}
+	
+	void move(size_t slot, size_t value, range rg, float score)
+	{
+		m_current[slot] = value;
+		m_circ.commit(slot, m_avail[value]);
+		m_best.moves++;
+		if (score > m_best.score)
+		{
+			std::copy(m_current.begin(), m_current.end(), m_best.indices.begin());
+			m_best.rg = rg;
+			m_best.score = score;
+		}
+	}
+	
+	const solution &finish()
+	{
+		canonicalize(m_prog, m_best.indices.data());
+		return m_best;
+	}
+	
+	const circuit_program &m_prog;
+	const std::vector<float> &m_avail;
+	range m_target;
+	incremental_circuit m_circ;
+	std::vector<float> m_values;
+	std::vector<size_t> m_current;
+	solution m_best;
+};
+
+/*
+	Simulated annealing from a random starting point, with geometric cooling.
+	Moves change a single resistor by a few positions, or occasionally to a
+	random value. Scores are absolute errors, so temperatures are relative to
+	the target.
+*/
+class annealing_strategy : public walk_strategy
+{
+public:
+	using walk_strategy::walk_strategy;
+	
+	const solution &step(std::mt19937 &rng) override
+	{
+		constexpr float t_start = 0.05f, t_end = 1e-6f;
+		size_t steps = 300 * m_current.size();
+		
+		std::uniform_int_distribution<size_t> slot_dist(0, m_current.size() - 1);
+		std::uniform_int_distribution<size_t> value_dist(0, m_avail.size() - 1);
+		std::uniform_int_distribution<int> delta_dist(-3, 3);
+		std::uniform_real_distribution<float> unit(0.f, 1.f);
+		
+		float score = random_start(rng);
+		float scale = std::max((m_target.first + m_target.second) / 2, 1.f);
+		float t = t_start * scale;
+		float cooling = std::pow(t_end / t_start, 1.f / steps);
+		
+		for (auto k = 0u; k < steps && m_best.score < 0; k++, t *= cooling)
+		{
+			auto slot = slot_dist(rng);
+			auto delta = delta_dist(rng);
+			auto value = delta ? std::clamp<std::ptrdiff_t>(m_current[slot] + delta, 0, m_avail.size() - 1) : value_dist(rng);
+			if (value == m_current[slot])
+				continue;
+			
+			auto rg = m_circ.probe(slot, m_avail[value]);
+			float s = range_score(m_target, rg);
+			m_best.evals++;
+			
+			if (s >= score || unit(rng) < std::exp((s - score) / t))
+			{
+				move(slot, value, rg, s);
+				score = s;
+			}
+		}
+		
+		return finish();
+	}
+};
+
+/*
+	Tabu search from a random starting point. Every iteration takes the best
+	move in the neighbourhood, even if it's worse than the current solution,
+	except for moves bringing a resistor back to a value it has recently left -
+	unless they'd improve on the best solution found.
+*/
+class tabu_strategy : public walk_strategy
+{
+public:
+	tabu_strategy(const circuit_program &prog, const std::vector<float> &avail, range target) :
+		walk_strategy(prog, avail, target),
+		m_tabu_until(prog.size() * avail.size())
+	{
+	}
+	
+	const solution &step(std::mt19937 &rng) override
+	{
+		size_t n = m_current.size();
+		size_t iterations = 20 * n;
+		size_t tenure = 2 + n / 2;
+		
+		random_start(rng);
+		std::fill(m_tabu_until.begin(), m_tabu_until.end(), 0);
+		
+		for (auto it = 1u; it <= iterations && m_best.score < 0; it++)
+		{
+			size_t best_slot = 0, best_value = 0;
+			float best_score = -INF;
+			range best_rg;
+			
+			for (auto slot = 0u; slot < n; slot++)
+			{
+				size_t cand[max_neighbour_values];
+				auto count = neighbour_values(m_circ, m_avail, m_target, slot, m_current[slot], cand);
+				for (auto j = 0u; j < count; j++)
+				{
+					auto rg = m_circ.probe(slot, m_avail[cand[j]]);
+					float s = range_score(m_target, rg);
+					m_best.evals++;
+					
+					bool tabu = m_tabu_until[slot * m_avail.size() + cand[j]] >= it;
+					if ((!tabu || s > m_best.score) && s > best_score)
+					{
+						best_slot = slot;
+						best_value = cand[j];
+						best_score = s;
+						best_rg = rg;
+					}
+				}
+			}
+			
+			if (best_score == -INF)
+				break;
+			
+			m_tabu_until[best_slot * m_avail.size() + m_current[best_slot]] = it + tenure;
+			move(best_slot, best_value, best_rg, best_score);
+		}
+		
+		return finish();
+	}
+
+private:
+	std::vector<size_t> m_tabu_until; //!< Last iteration a value is tabu for a resistor
+};
+
+/*
+	Genetic algorithm with a population kept between steps. Children are made
+	by uniform crossover of the index vectors of two parents picked in
+	tournaments, and mutated by moving single resistors by one position or to
+	a random value. All individuals are kept in canonical form, so that parents
+	with identical siblings swapped don't give broken children. The best
+	individuals always survive. Whole generations are evaluated with the batch
+	kernels.
+*/
+class genetic_strategy : public search_strategy
+{
+public:
+	genetic_strategy(const circuit_program &prog, const std::vector<float> &avail, range target) :
+		m_prog(prog),
+		m_avail(avail),
+		m_target(target),
+		m_kernel(get_batch_kernel(prog)),
+		m_population(population_size * prog.size()),
+		m_children(population_size * prog.size()),
+		m_scores(population_size),
+		m_ranges(population_size),
+		m_batch_values(prog.size() * batch_lanes)
+	{
+		m_best.indices.resize(prog.size());
+	}
+	
+	void reset(range target) override
+	{
+		m_target = target;
+		m_initialized = false;
+	}
+	
+	const solution &step(std::mt19937 &rng) override
+	{
+		constexpr size_t elite = 2, tournament = 3;
+		size_t n = m_prog.size();
+		std::uniform_int_distribution<size_t> value_dist(0, m_avail.size() - 1);
+		std::uniform_int_distribution<size_t> member_dist(0, population_size - 1);
+		std::uniform_real_distribution<float> unit(0.f, 1.f);
+		m_best.evals = 0;
+		
+		if (!m_initialized)
+		{
+			for (auto &i : m_population)
+				i = value_dist(rng);
+			for (auto c = 0u; c < population_size; c++)
+				canonicalize(m_prog, &m_population[c * n]);
+			evaluate(m_population);
+			m_initialized = true;
+		}
+		
+		auto select = [&]
+		{
+			size_t best = member_dist(rng);
+			for (auto i = 1u; i < tournament; i++)
+			{
+				size_t c = member_dist(rng);
+				if (m_scores[c] > m_scores[best])
+					best = c;
+			}
+			return &m_population[best * n];
+		};
+		
+		// The elite is copied as it is
+		std::partial_sort(m_order.begin(), m_order.begin() + elite, m_order.end(), [this](auto a, auto b){
+			return m_scores[a] > m_scores[b];
+		});
+		for (auto e = 0u; e < elite; e++)
+			std::copy_n(&m_population[m_order[e] * n], n, &m_children[e * n]);
+		
+		float mutation_rate = 1.f / n;
+		for (auto c = elite; c < population_size; c++)
+		{
+			auto a = select(), b = select();
+			auto child = &m_children[c * n];
+			for (auto i = 0u; i < n; i++)
+			{
+				child[i] = unit(rng) < 0.5f ? a[i] : b[i];
+				if (unit(rng) < mutation_rate)
+				{
+					if (unit(rng) < 0.5f)
+						child[i] = value_dist(rng);
+					else if (child[i] > 0 && (unit(rng) < 0.5f || child[i] == m_avail.size() - 1))
+						child[i]--;
+					else
+						child[i]++;
+				}
+			}
+			
+			canonicalize(m_prog, child);
+		}
+		
+		std::swap(m_population, m_children);
+		evaluate(m_population);
+		
+		auto best = std::max_element(m_scores.begin(), m_scores.end()) - m_scores.begin();
+		std::copy_n(&m_population[best * n], n, m_best.indices.begin());
+		m_best.rg = m_ranges[best];
+		m_best.score = m_scores[best];
+		m_best.moves = population_size - elite; // Children replacing their parents
+		return m_best;
+	}
+
+private:
+	static constexpr size_t population_size = 64;
+	static_assert(population_size % batch_lanes == 0);
+	
+	void evaluate(const std::vector<size_t> &population)
+	{
+		alignas(64) float lo[batch_lanes];
+		alignas(64) float hi[batch_lanes];
+		size_t n = m_prog.size();
+		
+		for (auto b = 0u; b < population_size; b += batch_lanes)
+		{
+			for (auto l = 0u; l < batch_lanes; l++)
+				for (auto i = 0u; i < n; i++)
+					m_batch_values[i * batch_lanes + l] = m_avail[population[(b + l) * n + i]];
+			
+			m_kernel.eval(m_prog, m_batch_values.data(), lo, hi);
+			
+			for (auto l = 0u; l < batch_lanes; l++)
+			{
+				m_ranges[b + l] = {lo[l], hi[l]};
+				m_scores[b + l] = range_score(m_target, m_ranges[b + l]);
+			}
+		}
+		
+		for (auto i = 0u; i < population_size; i++)
+			m_order[i] = i;
+		m_best.evals += population_size;
+	}
+	
+	const circuit_program &m_prog;
+	const std::vector<float> &m_avail;
+	range m_target;
+	batch_kernel m_kernel;
+	bool m_initialized = false;
+	std::vector<size_t> m_population; //!< Index vectors of all individuals, one after another
+	std::vector<size_t> m_children;
+	std::vector<float> m_scores;
+	std::vector<range> m_ranges;
+	std::array<size_t, population_size> m_order;
+	std::vector<float> m_batch_values;
+	solution m_best;
+};
+
+const std::vector<std::string> &get_strategy_names()
+{
+	static const std::vector<std::string> names{"descent", "steepest", "anneal", "tabu", "genetic"};
+	return names;
+}
+
+std::unique_ptr<search_strategy> make_strategy(const std::string &name, const circuit_program &prog, const std::vector<float> &avail, range target)
+{
+	if (name == "descent")
+		return std::make_unique<restart_strategy>(prog, avail, target, false);
+	else if (name == "steepest")
+		return std::make_unique<restart_strategy>(prog, avail, target, true);
+	else if (name == "anneal")
+		return std::make_unique<annealing_strategy>(prog, avail, target);
+	else if (name == "tabu")
+		return std::make_unique<tabu_strategy>(prog, avail, target);
+	else if (name == "genetic")
+		return std::make_unique<genetic_strategy>(prog, avail, target);
+	
+	throw std::runtime_error{"unknown strategy '" + name + "'"};
+}
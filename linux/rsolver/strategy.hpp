@@ -0,0 +1,28 @@
+#pragma once
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include "search.hpp"
+
+/*
+	Search strategy, run independently on every thread. Each step is one
+	generation of the strategy - a restart of a local search, an annealing run,
+	or a generation of the genetic algorithm - and returns the best solution
+	it has found. The solution is in canonical form (see canonicalize()), and
+	only valid until the next step.
+*/
+class search_strategy
+{
+public:
+	virtual ~search_strategy() = default;
+	
+	//! Changes the target, discarding any state kept between steps
+	virtual void reset(range target) = 0;
+	virtual const solution &step(std::mt19937 &rng) = 0;
+};
+
+//! Names of all available strategies
+const std::vector<std::string> &get_strategy_names();
+
+std::unique_ptr<search_strategy> make_strategy(const std::string &name, const circuit_program &prog, const std::vector<float> &avail, range target);
@@ -0,0 +1,63 @@
+#include "targets.hpp"
+#include "circuit.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+std::vector<float> read_targets(std::istream &in)
+{
+	std::vector<float> targets;
+	std::string line;
+	while (std::getline(in, line))
+	{
+		std::stringstream ss{line.substr(0, line.find('#'))};
+		std::string token;
+		while (ss >> token)
+			targets.push_back(from_si_string(token));
+	}
+	
+	return targets;
+}
+
+void solve_targets(const std::vector<float> &targets, unsigned threads,
+	const std::function<target_result(size_t, unsigned)> &solve,
+	const std::function<void(size_t, const target_result&)> &on_result)
+{
+	std::vector<target_result> results(targets.size());
+	std::vector<bool> done(targets.size());
+	std::atomic<size_t> next{0};
+	std::mutex done_mutex;
+	std::condition_variable done_cv;
+	
+	// Targets are handed out one by one, as their solving times can vary a lot
+	auto worker = [&](unsigned thread_id)
+	{
+		for (size_t i; (i = next.fetch_add(1)) < targets.size();)
+		{
+			auto result = solve(i, thread_id);
+			std::lock_guard lock{done_mutex};
+			results[i] = std::move(result);
+			done[i] = true;
+			done_cv.notify_one();
+		}
+	};
+	
+	std::vector<std::thread> pool;
+	for (auto i = 0u; i < threads; i++)
+		pool.emplace_back(worker, i);
+	
+	for (auto i = 0u; i < targets.size(); i++)
+	{
+		std::unique_lock lock{done_mutex};
+		done_cv.wait(lock, [&]{return done[i];});
+		auto result = std::move(results[i]);
+		lock.unlock();
+		
+		on_result(i, result);
+	}
+	
+	for (auto &t : pool)
+		t.join();
+}
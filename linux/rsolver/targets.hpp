@@ -0,0 +1,27 @@
+#pragma once
+#include <functional>
+#include <istream>
+#include <string>
+#include <vector>
+
+struct target_result
+{
+	float target;
+	float value = 0;
+	std::string desc;
+};
+
+/*
+	Reads whitespace-separated target values (with SI suffixes). Everything
+	after a '#' is ignored.
+*/
+std::vector<float> read_targets(std::istream &in);
+
+/*
+	Solves all targets on the given number of threads. The solver is called
+	with the index of the target and the thread number. Results are reported through the
+	callback in input order, always on the calling thread.
+*/
+void solve_targets(const std::vector<float> &targets, unsigned threads,
+	const std::function<target_result(size_t, unsigned)> &solve,
+	const std::function<void(size_t, const target_result&)> &on_result);
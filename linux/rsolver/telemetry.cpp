@@ -0,0 +1,39 @@
+#include "telemetry.hpp"
+#include <stdexcept>
+
+telemetry_writer::telemetry_writer(const std::string &path) :
+	m_out(path),
+	m_json(path.size() >= 5 && path.compare(path.size() - 5, 5, ".json") == 0)
+{
+	if (!m_out)
+		throw std::runtime_error{"could not open telemetry file " + path};
+	
+	m_out.precision(9);
+	if (!m_json)
+		m_out << "time,evals,generations,moves,current_score,best_score,evals_per_second,moves_per_second" << std::endl;
+}
+
+void telemetry_writer::write(const telemetry_sample &s)
+{
+	// Scores are -INF before the first generation
+	bool scored = s.generations > 0;
+	if (m_json)
+	{
+		m_out << "{\"time\": " << s.time << ", \"evals\": " << s.evals << ", \"generations\": " << s.generations
+			<< ", \"moves\": " << s.moves << ", \"current_score\": ";
+		if (scored)
+			m_out << s.current_score << ", \"best_score\": " << s.best_score;
+		else
+			m_out << "null, \"best_score\": null";
+		m_out << ", \"evals_per_second\": " << s.evals_per_second << ", \"moves_per_second\": " << s.moves_per_second << "}" << std::endl;
+	}
+	else
+	{
+		m_out << s.time << "," << s.evals << "," << s.generations << "," << s.moves << ",";
+		if (scored)
+			m_out << s.current_score << "," << s.best_score;
+		else
+			m_out << ",";
+		m_out << "," << s.evals_per_second << "," << s.moves_per_second << std::endl;
+	}
+}
@@ -0,0 +1,21 @@
+#pragma once
+#include <fstream>
+#include <string>
+#include "search.hpp"
+
+/*
+	Writes telemetry samples to a file - as CSV with a header line, or, for
+	files ending with .json, as JSON objects, one per line. Every sample is
+	flushed, so the file can be followed while the search runs. Scores are
+	left empty (null) until the first generation is done.
+*/
+class telemetry_writer
+{
+public:
+	telemetry_writer(const std::string &path);
+	void write(const telemetry_sample &s);
+
+private:
+	std::ofstream m_out;
+	bool m_json;
+};
@@ -0,0 +1,434 @@
+#include "topology.hpp"
+#include "program.hpp"
+#include "exact.hpp"
+#include <algorithm>
+#include <functional>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+topology_solver::topology_solver(const std::vector<float> &avail, int max_leaves, size_t max_table_size) :
+	m_avail(avail),
+	m_max_table_size(max_table_size)
+{
+	m_topologies.push_back({'r', {}, -1, 1, "r"});
+	m_ids["r"] = 0;
+	
+	for (int n = 2; n <= max_leaves; n++)
+	{
+		add_blocks('(', n);
+		add_blocks('[', n);
+	}
+	
+	m_tables.resize(m_topologies.size());
+	m_table_built.resize(m_topologies.size());
+	m_splits.resize(m_topologies.size());
+	m_split_built.resize(m_topologies.size());
+	m_split_costs.resize(m_topologies.size(), SIZE_MAX);
+}
+
+/*
+	Generates all blocks of given type with given number of leaves. Children
+	are multisets of resistors and smaller blocks of the other type.
+*/
+void topology_solver::add_blocks(char type, int leaves)
+{
+	char other = type == '(' ? '[' : '(';
+	char close = type == '(' ? ')' : ']';
+	
+	std::vector<int> pool;
+	for (auto i = 0u; i < m_topologies.size(); i++)
+		if (m_topologies[i].type == 'r' || (m_topologies[i].type == other && m_topologies[i].leaves < leaves))
+			pool.push_back(i);
+	
+	auto make_desc = [&](const std::vector<int> &children)
+	{
+		std::string desc{type};
+		for (auto c : children)
+			desc += m_topologies[c].desc;
+		return desc + close;
+	};
+	
+	std::vector<int> chosen;
+	std::function<void(size_t, int)> choose = [&](size_t start, int remaining)
+	{
+		if (remaining == 0)
+		{
+			if (chosen.size() < 2)
+				return;
+			
+			topology t{type, chosen, -1, leaves, make_desc(chosen)};
+			if (chosen.size() == 2)
+				t.prefix = chosen[0];
+			else
+				t.prefix = m_ids.at(make_desc({chosen.begin(), chosen.end() - 1}));
+			
+			m_ids[t.desc] = m_topologies.size();
+			m_topologies.push_back(std::move(t));
+			return;
+		}
+		
+		for (auto i = start; i < pool.size(); i++)
+		{
+			if (m_topologies[pool[i]].leaves > remaining)
+				continue;
+			
+			chosen.push_back(pool[i]);
+			choose(i, remaining - m_topologies[pool[i]].leaves);
+			chosen.pop_back();
+		}
+	};
+	
+	choose(0, leaves);
+}
+
+/*
+	Returns sorted table of distinct values reachable by the topology, or null if
+	the table would be too large. Tables are memoized, so sub-topologies shared
+	between topologies are only computed once.
+*/
+const std::vector<table_entry> *topology_solver::get_table(int id)
+{
+	if (m_table_built[id])
+		return m_tables[id].empty() ? nullptr : &m_tables[id];
+	
+	m_table_built[id] = true;
+	const auto &t = m_topologies[id];
+	auto &table = m_tables[id];
+	
+	if (t.type == 'r')
+	{
+		for (auto i = 0u; i < m_avail.size(); i++)
+			table.push_back({m_avail[i], i, 0});
+	}
+	else
+	{
+		auto a = get_table(t.prefix);
+		auto b = get_table(t.children.back());
+		if (!a || !b || a->size() * b->size() > m_max_table_size)
+			return nullptr;
+		
+		table.reserve(a->size() * b->size());
+		for (auto i = 0u; i < a->size(); i++)
+			for (auto j = 0u; j < b->size(); j++)
+			{
+				float x = (*a)[i].value, y = (*b)[j].value;
+				table.push_back({t.type == '(' ? x + y : parallel2(x, y), i, j});
+			}
+	}
+	
+	std::sort(table.begin(), table.end(), [](const auto &lhs, const auto &rhs){
+		return lhs.value < rhs.value;
+	});
+	
+	table.erase(std::unique(table.begin(), table.end(), [](const auto &lhs, const auto &rhs){
+		return lhs.value == rhs.value;
+	}), table.end());
+	table.shrink_to_fit();
+	
+	return &table;
+}
+
+void topology_solver::collect_values(int id, std::uint32_t entry, std::vector<float> &values) const
+{
+	const auto &t = m_topologies[id];
+	const auto &e = m_tables[id][entry];
+	
+	if (t.type == 'r')
+	{
+		values.push_back(m_avail[e.a]);
+	}
+	else
+	{
+		collect_values(t.prefix, e.a, values);
+		collect_values(t.children.back(), e.b, values);
+	}
+}
+
+std::string topology_solver::describe(int id, const std::vector<float> &values) const
+{
+	if (m_topologies[id].type == 'r')
+		return to_si_string(values[0]);
+	
+	auto circuit = str_to_circuit(m_topologies[id].desc);
+	auto res = circuit->get_resistances();
+	for (auto i = 0u; i < res.size(); i++)
+		*res[i] = values[i];
+	
+	return circuit->describe();
+}
+
+static size_t saturating_mul(size_t a, size_t b)
+{
+	return b != 0 && a > SIZE_MAX / b ? SIZE_MAX : a * b;
+}
+
+float topology_solver::match_objective::error(float v) const
+{
+	for (auto it = outer.rbegin(); it != outer.rend(); ++it)
+		v = it->first ? it->second + v : parallel2(it->second, v);
+	return std::abs(v - target);
+}
+
+// The error only grows away from t, so the best entry is one of the two around it
+size_t topology_solver::nearest_entry(const std::vector<table_entry> &table, float t, const match_objective &obj) const
+{
+	auto it = std::lower_bound(table.begin(), table.end(), t, [](const auto &e, float x){
+		return e.value < x;
+	});
+	
+	size_t pos = it - table.begin();
+	if (pos == table.size() || (pos > 0 && obj.error(table[pos - 1].value) < obj.error(table[pos].value)))
+		return pos - 1;
+	return pos;
+}
+
+/*
+	Finds a way of splitting the children of a block into two groups, so that
+	the block is a serial/parallel combination of two smaller topologies, at
+	least one of which has a table. The split with the lowest estimated cost
+	of matching a value is chosen.
+*/
+const topology_solver::split *topology_solver::get_split(int id)
+{
+	if (m_split_built[id])
+		return m_splits[id].s < 0 ? nullptr : &m_splits[id];
+	
+	m_split_built[id] = true;
+	m_splits[id] = {-1, -1, 0};
+	const auto &t = m_topologies[id];
+	if (t.type == 'r')
+		return nullptr;
+	
+	char close = t.type == '(' ? ')' : ']';
+	auto group_id = [&](const std::vector<int> &children)
+	{
+		if (children.size() == 1)
+			return children[0];
+		
+		std::string desc{t.type};
+		for (auto c : children)
+			desc += m_topologies[c].desc;
+		return m_ids.at(desc + close);
+	};
+	
+	size_t best_cost = SIZE_MAX;
+	auto k = t.children.size();
+	
+	// The first child always stays in the first group, so every split is only visited once
+	for (std::uint32_t mask = 1; mask < (1u << k) - 1; mask += 2)
+	{
+		std::vector<int> ga, gb;
+		for (auto i = 0u; i < k; i++)
+			(mask & (1u << i) ? ga : gb).push_back(t.children[i]);
+		
+		int a = group_id(ga), b = group_id(gb);
+		auto ta = get_table(a), tb = get_table(b);
+		if (!ta && !tb)
+			continue;
+		
+		// Iterating over table A and searching in table B, or recursing into B
+		auto consider = [&](int s, int o, std::uint32_t s_mask, size_t cost)
+		{
+			if (cost < best_cost)
+			{
+				best_cost = cost;
+				m_splits[id] = {s, o, s_mask};
+			}
+		};
+		
+		auto other_mask = ((1u << k) - 1) & ~mask;
+		if (ta)
+			consider(a, b, mask, saturating_mul(ta->size(), match_cost(b)));
+		if (tb)
+			consider(b, a, other_mask, saturating_mul(tb->size(), match_cost(a)));
+	}
+	
+	m_split_costs[id] = best_cost;
+	return m_splits[id].s < 0 ? nullptr : &m_splits[id];
+}
+
+/*
+	Estimated number of steps needed to match a value of the topology - the
+	product of the sizes of iterated tables.
+*/
+size_t topology_solver::match_cost(int id)
+{
+	if (get_table(id))
+		return 1;
+	
+	get_split(id);
+	return m_split_costs[id];
+}
+
+float topology_solver::extreme_value(int id, float leaf) const
+{
+	const auto &t = m_topologies[id];
+	if (t.type == 'r')
+		return leaf;
+	
+	float v = extreme_value(t.children[0], leaf);
+	for (auto i = 1u; i < t.children.size(); i++)
+	{
+		float x = extreme_value(t.children[i], leaf);
+		v = t.type == '(' ? v + x : parallel2(v, x);
+	}
+	
+	return v;
+}
+
+/*
+	Finds the topology's value nearest to t using only the tables - directly if
+	the topology is tabulated, or by meet-in-the-middle otherwise: one side of a
+	split is iterated, and the complement value is looked up in (or recursively
+	matched by) the other one. Nearest means the smallest error of the whole
+	topology according to obj, for which t is the ideal value of this part.
+	Returns false if that's not possible.
+*/
+bool topology_solver::match(int id, float t, match_objective &obj, value_match &m)
+{
+	// The value is monotone in every leaf, so beyond the extremes it's trivial
+	for (auto leaf : {m_avail.front(), m_avail.back()})
+	{
+		float v = extreme_value(id, leaf);
+		if (leaf == m_avail.front() ? t <= v : t >= v)
+		{
+			m.value = v;
+			m.values.assign(m_topologies[id].leaves, leaf);
+			return true;
+		}
+	}
+	
+	if (auto table = get_table(id))
+	{
+		auto i = nearest_entry(*table, t, obj);
+		m.value = (*table)[i].value;
+		m.values.clear();
+		collect_values(id, i, m.values);
+		return true;
+	}
+	
+	auto sp = get_split(id);
+	if (!sp)
+		return false;
+	
+	const auto &topo = m_topologies[id];
+	bool is_serial = topo.type == '(';
+	const auto &ts = *get_table(sp->s);
+	auto to = get_table(sp->o);
+	
+	// In serial blocks, each part is smaller than the total - and larger in parallel ones.
+	// Beyond the target, only the entry closest to it needs to be checked.
+	size_t begin = 0, end = ts.size();
+	auto pos = std::lower_bound(ts.begin(), ts.end(), t, [](const auto &e, float x){return e.value < x;}) - ts.begin();
+	if (is_serial)
+		end = std::min<size_t>(pos + 1, ts.size());
+	else
+		begin = pos > 0 ? pos - 1 : 0;
+	
+	float best_error = 0;
+	size_t best_s = 0, best_o = 0;
+	value_match sub, best_sub;
+	for (auto i = begin; i < end; i++)
+	{
+		float s = ts[i].value;
+		float comp;
+		if (is_serial)
+			comp = t - s;
+		else
+			comp = s > t ? t * s / (s - t) : std::numeric_limits<float>::max();
+		
+		float o;
+		size_t j = 0;
+		bool found = true;
+		obj.outer.emplace_back(is_serial, s);
+		if (to)
+		{
+			j = nearest_entry(*to, comp, obj);
+			o = (*to)[j].value;
+		}
+		else
+		{
+			found = match(sp->o, comp, obj, sub);
+			o = sub.value;
+		}
+		obj.outer.pop_back();
+		if (!found)
+			return false;
+		
+		float v = is_serial ? s + o : parallel2(s, o);
+		float error = obj.error(v);
+		if (i == begin || error < best_error)
+		{
+			best_error = error;
+			m.value = v;
+			best_s = i;
+			best_o = j;
+			if (!to)
+				std::swap(best_sub, sub);
+		}
+	}
+	
+	std::vector<float> vs, vo;
+	collect_values(sp->s, best_s, vs);
+	if (to)
+		collect_values(sp->o, best_o, vo);
+	else
+		vo = std::move(best_sub.values);
+	
+	// Leaves of the two groups are merged back in the order of the block's children
+	m.values.clear();
+	auto is = vs.begin(), io = vo.begin();
+	for (auto i = 0u; i < topo.children.size(); i++)
+	{
+		auto &it = sp->s_mask & (1u << i) ? is : io;
+		m.values.insert(m.values.end(), it, it + m_topologies[topo.children[i]].leaves);
+		it += m_topologies[topo.children[i]].leaves;
+	}
+	
+	return true;
+}
+
+/*
+	Builds all tables and splits the matching can use in advance, which is
+	otherwise done lazily. Afterwards, solve() doesn't modify the solver, and
+	can be called from multiple threads at once.
+*/
+void topology_solver::prepare()
+{
+	for (auto id = 0u; id < m_topologies.size(); id++)
+		if (!get_table(id))
+			get_split(id);
+}
+
+/*
+	Finds the best values for the topology - using the value tables if possible,
+	or with the branch-and-bound search otherwise. In the latter case, only
+	solutions better than the incumbent score are returned.
+*/
+topology_solution topology_solver::solve(int id, range target, float incumbent)
+{
+	value_match m;
+	float t = (target.first + target.second) / 2;
+	match_objective obj{t, {}};
+	if (match(id, t, obj, m))
+	{
+		range rg{m.value, m.value};
+		return {id, range_score(target, rg), rg, describe(id, m.values), true, m.values};
+	}
+	
+	// Only solutions better than the incumbent are of interest, which allows
+	// pruning much more aggressively
+	auto circuit = str_to_circuit(m_topologies[id].desc);
+	exact_solver solver(*circuit, m_avail, target);
+	solver.best_score = incumbent;
+	solver.solve([](const exact_solver &){});
+	if (solver.best_indices.empty())
+		return {id, -INF, {0, 0}, "", false, {}};
+	
+	std::vector<float> values;
+	for (auto i : solver.best_indices)
+		values.push_back(m_avail[i]);
+	
+	return {id, solver.best_score, solver.best_range, solver.best_desc(), false, values};
+}
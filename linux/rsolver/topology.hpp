@@ -0,0 +1,100 @@
+#pragma once
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+#include "circuit.hpp"
+
+/*
+	Canonical series-parallel topology. Serial blocks only contain resistors
+	and parallel blocks (and vice versa), with children ordered by their IDs,
+	so every network is generated exactly once.
+*/
+struct topology
+{
+	char type;                 //!< 'r' - resistor, '(' - serial, '[' - parallel
+	std::vector<int> children;
+	int prefix = -1;           //!< The same block without its last child
+	int leaves = 1;
+	std::string desc;          //!< Canonical form, in the circuit grammar
+};
+
+/*
+	Value reachable by a topology. Composite values refer to entries in the
+	tables of the prefix and the last child. For single resistors, `a` is the
+	index in the available values.
+*/
+struct table_entry
+{
+	float value;
+	std::uint32_t a;
+	std::uint32_t b;
+};
+
+struct topology_solution
+{
+	int id;
+	float score;
+	range rg;
+	std::string desc;
+	bool tabled; //!< Found using the value tables rather than a search
+	std::vector<float> values; //!< Leaf values, in the order of get_resistances()
+};
+
+class topology_solver
+{
+public:
+	topology_solver(const std::vector<float> &avail, int max_leaves, size_t max_table_size = 1u << 22);
+	
+	const std::vector<topology> &get_topologies() const {return m_topologies;}
+	void prepare();
+	topology_solution solve(int id, range target, float incumbent = -INF);
+
+private:
+	struct split
+	{
+		int s;               //!< Tabulated side, which is iterated
+		int o;               //!< Other side
+		std::uint32_t s_mask; //!< Children of the block belonging to the s side
+	};
+	
+	struct value_match
+	{
+		float value = 0;
+		std::vector<float> values; //!< Leaf values, in canonical order
+	};
+	
+	/*
+		Error of the whole topology for a value of the part being matched. The
+		part is combined with the values already chosen for the other sides of
+		the enclosing splits, innermost last - parallel combinations aren't
+		linear, so the value nearest to the complement isn't always the best.
+	*/
+	struct match_objective
+	{
+		float target;
+		std::vector<std::pair<bool, float>> outer; //!< Serial or not, value of the other side
+		
+		float error(float v) const;
+	};
+	
+	void add_blocks(char type, int leaves);
+	const std::vector<table_entry> *get_table(int id);
+	const split *get_split(int id);
+	size_t match_cost(int id);
+	float extreme_value(int id, float leaf) const;
+	size_t nearest_entry(const std::vector<table_entry> &table, float t, const match_objective &obj) const;
+	bool match(int id, float t, match_objective &obj, value_match &m);
+	void collect_values(int id, std::uint32_t entry, std::vector<float> &values) const;
+	std::string describe(int id, const std::vector<float> &values) const;
+	
+	const std::vector<float> &m_avail;
+	size_t m_max_table_size;
+	std::vector<topology> m_topologies;
+	std::map<std::string, int> m_ids;
+	std::vector<std::vector<table_entry>> m_tables;
+	std::vector<bool> m_table_built;
+	std::vector<split> m_splits;
+	std::vector<bool> m_split_built;
+	std::vector<size_t> m_split_costs;
+};
@@ -0,0 +1,125 @@
+#include "yield.hpp"
+#include "batch.hpp"
+#include <cfloat>
+#include <cmath>
+
+/*
+	Independent xorshift32 generator in every lane - the lane loops are
+	vectorized, unlike with the generators from <random>.
+*/
+struct lane_rng
+{
+	lane_rng(std::uint64_t seed)
+	{
+		std::uint64_t x = seed;
+		for (auto &s : state)
+		{
+			// splitmix64, so that similar seeds give unrelated streams
+			x += 0x9e3779b97f4a7c15;
+			std::uint64_t z = x;
+			z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+			z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+			s = (z ^ (z >> 31)) | 1;
+		}
+	}
+	
+	// Uniform values in [center - spread, center + spread)
+	void next(float *out, float center, float spread)
+	{
+		for (auto l = 0u; l < batch_lanes; l++)
+		{
+			std::uint32_t x = state[l];
+			x ^= x << 13;
+			x ^= x >> 17;
+			x ^= x << 5;
+			state[l] = x;
+			out[l] = center + spread * (static_cast<float>(x >> 8) * (1.f / (1u << 23)) - 1.f);
+		}
+	}
+	
+	alignas(64) std::uint32_t state[batch_lanes];
+};
+
+yield_report estimate_yield(const circuit_program &prog, const float *values, float target, const yield_config &cfg)
+{
+	// Drawn values are evaluated exactly. Fixed resistors are nominal.
+	circuit_program exact = prog;
+	std::fill(exact.tols.begin(), exact.tols.end(), 0.f);
+	for (auto &c : exact.constants)
+		c.first = c.second = (c.first + c.second) / 2;
+	
+	yield_report report;
+	report.histogram.resize(yield_histogram_bins);
+	report.histogram_range = prog.eval(values);
+	float hist_lo = report.histogram_range.first;
+	float hist_scale = yield_histogram_bins / std::max(report.histogram_range.second - hist_lo, 1e-30f);
+	
+	float spec_lo = target * (1.f - cfg.spec);
+	float spec_hi = target * (1.f + cfg.spec);
+	
+	auto kernel = get_batch_kernel(exact);
+	lane_rng rng{cfg.seed};
+	std::vector<float> batch_values(prog.size() * batch_lanes);
+	alignas(64) float lo[batch_lanes];
+	alignas(64) float hi[batch_lanes];
+	
+	// Statistics are accumulated per lane, and flushed to double precision
+	// every so often to avoid losing precision
+	constexpr size_t flush_interval = 1024;
+	alignas(64) std::uint32_t lane_in_spec[batch_lanes] = {};
+	alignas(64) float lane_sum[batch_lanes] = {};
+	alignas(64) float lane_sum_sq[batch_lanes] = {};
+	alignas(64) float lane_min[batch_lanes];
+	alignas(64) float lane_max[batch_lanes];
+	std::fill_n(lane_min, batch_lanes, FLT_MAX);
+	std::fill_n(lane_max, batch_lanes, -FLT_MAX);
+	
+	size_t in_spec = 0;
+	double sum = 0, sum_sq = 0;
+	size_t batches = (cfg.samples + batch_lanes - 1) / batch_lanes;
+	report.samples = batches * batch_lanes;
+	for (size_t b = 0; b < batches; b++)
+	{
+		for (auto s = 0u; s < prog.size(); s++)
+			rng.next(&batch_values[s * batch_lanes], values[s], values[s] * prog.tols[s]);
+		
+		kernel.eval(exact, batch_values.data(), lo, hi);
+		
+		for (auto l = 0u; l < batch_lanes; l++)
+		{
+			float r = lo[l];
+			lane_in_spec[l] += r >= spec_lo && r <= spec_hi;
+			lane_sum[l] += r;
+			lane_sum_sq[l] += r * r;
+			lane_min[l] = std::min(lane_min[l], r);
+			lane_max[l] = std::max(lane_max[l], r);
+		}
+		
+		for (auto l = 0u; l < batch_lanes; l++)
+		{
+			auto bin = static_cast<size_t>(std::max((lo[l] - hist_lo) * hist_scale, 0.f));
+			report.histogram[std::min(bin, yield_histogram_bins - 1)]++;
+		}
+		
+		if (b % flush_interval == flush_interval - 1 || b == batches - 1)
+			for (auto l = 0u; l < batch_lanes; l++)
+			{
+				in_spec += lane_in_spec[l];
+				sum += lane_sum[l];
+				sum_sq += lane_sum_sq[l];
+				lane_in_spec[l] = 0;
+				lane_sum[l] = lane_sum_sq[l] = 0;
+			}
+	}
+	
+	float min = *std::min_element(lane_min, lane_min + batch_lanes);
+	float max = *std::max_element(lane_max, lane_max + batch_lanes);
+	
+	double mean = sum / report.samples;
+	report.yield = float(in_spec) / report.samples;
+	report.mean = mean;
+	report.stddev = std::sqrt(std::max(sum_sq / report.samples - mean * mean, 0.0));
+	report.min = min;
+	report.max = max;
+	return report;
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "program.hpp"
+
+constexpr size_t yield_histogram_bins = 20;
+
+struct yield_config
+{
+	float spec = 0.01f;       //!< Allowed relative deviation from the target
+	size_t samples = 1000000;
+	std::uint64_t seed = 0;
+};
+
+struct yield_report
+{
+	size_t samples = 0; //!< Requested number rounded up to whole batches
+	float yield = 0;    //!< Fraction of the samples in spec
+	float mean = 0;
+	float stddev = 0;
+	float min = 0;
+	float max = 0;
+	
+	//! Counts of samples in equal bins over the worst-case range
+	std::vector<size_t> histogram;
+	range histogram_range;
+};
+
+/*
+	Monte Carlo yield analysis. The value of every resistor is drawn uniformly
+	from its tolerance band (prog.tols), and the resistance is checked against
+	the target with the allowed deviation. The same seed always produces the
+	same draws, so solutions can be compared with each other fairly.
+*/
+yield_report estimate_yield(const circuit_program &prog, const float *values, float target, const yield_config &cfg);